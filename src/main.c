@@ -2,8 +2,18 @@
 // SECTION: Includes and Basic Type Definitions
 // =========================================================================
 
+#ifdef NATIVE
+#include <stdint.h>     // for uint8_t etc. (normally pulled in by the device header)
+#include <unistd.h>     // for read()
+#include <poll.h>       // for poll(), used to wait for host input
+#include <errno.h>      // for EINTR
+#include <signal.h>     // for SIGALRM, stands in for the deadline timer interrupt
+#include <sys/time.h>   // for setitimer()
+#include <time.h>       // for clock_gettime(), to time the consistency check
+#else
 #include <stm32f0xx.h>
 #include "clock_.h"
+#endif
 #include <stdio.h>      // for printf(), used via LOG() macro
 #include <string.h>     // for strcmp(), strcpy(), memset(), memcpy()
 #include <stdlib.h>     // for rand()
@@ -20,11 +30,66 @@
 
 #define BAUDRATE 115200     // UART baud rate
 
+#ifndef REPLY_DEADLINE_MS
+#define REPLY_DEADLINE_MS 100   // max. time from decoding HD_BOOM_x_y until our shot is sent
+#endif
+#define TICKS_PER_US 48     // tick counter runs at the 48 MHz core clock (SysTick, emulated on the host)
+#define TICK_MASK 0xFFFFFF  // the tick counter is 24 bits wide and wraps after ~350 ms
+
 #define FIELD_SIZE 100      // game field size (10 rows x 10 columns)
 #define ROWS 10             // number of rows
 #define COLS 10             // number of columns
 #define IDX(x, y) ((x) * 10 + (y))  // macro to convert (x, y) to 1D array index
 
+#define MAX_SHIP_LEN 5      // longest ship (battleship)
+
+#ifndef USE_DEDUCTION
+#define USE_DEDUCTION 1     // constraint propagation before targeting (0: off, for comparison)
+#endif
+#define DEDUCE_MAX_PASSES 10    // upper bound of propagation passes per turn
+
+#ifndef USE_CONSIST_CHECK
+#define USE_CONSIST_CHECK 1 // check after every reply that a legal enemy fleet still fits (0: off)
+#endif
+#ifndef CHEAT_END_GAME
+#define CHEAT_END_GAME 0    // 1: stop playing once the opponent is caught lying (DH_#END, wait for the next HD_START)
+#endif
+#define CONSIST_MAX_NODES 500   // search budget per attempt, an exhausted budget counts as "consistent"
+#define CONSIST_ATTEMPTS 4  // attempts per check, each with its own random choice order
+#define FLEET_SHIPS 10      // ships per fleet
+
+#ifndef USE_FINGERPRINT
+#define USE_FINGERPRINT 1   // recognise opponents and use their learned models (0: off, for comparison)
+#endif
+#ifndef USE_FP_PRIOR
+#define USE_FP_PRIOR 0      // 1: also learn where they place ships and search there first (costs shots, see arena)
+#endif
+#define MAX_PROFILES 4      // opponent profiles kept in RAM
+#define OPENING_LEN 6       // opponent shots used for the fingerprint
+#define SHOT_ORDER_LEN 20   // opponent shots that feed the shot-order model
+#define FP_FEATURES 4       // size of the fingerprint vector
+#define FP_MATCH_MAX 2.5f   // max. distance (mean squared z-score) to accept a profile, ~96% of an opponent's own games
+#define FP_STICKY 0.5f      // distance bonus of the active profile (opponents play several games in a row)
+#define FP_MAX_GAMES 100    // games per profile before its statistics are halved
+
+#ifndef USE_CS_SPREAD
+#define USE_CS_SPREAD 1     // prefer fields whose row checksums are evenly spread (0: off, for comparison)
+#endif
+#define CS_SPREAD_MAX 20    // max. checksum leakage (squared deviation from 3 parts per row) of the preferred class
+#define LAYOUT_TRIES 8      // max. fields generated per game when choosing one
+
+#define HEATMAP_HIT_WEIGHT 8    // heatmap weight factor per hit a ship placement runs through
+#ifndef HEATMAP_STREAM
+#define HEATMAP_STREAM 0    // stream the targeting heatmap after each of our shots (toggle: DD_HEATMAP_ON/OFF)
+#endif
+
+/*
+ * NATIVE: build the game for the host instead of the Nucleo board
+ * (PlatformIO env "native", or task/arena.py). UART I/O is replaced by
+ * stdin/stdout, which the host tools connect to a pty, so schiff.py can
+ * talk to it like to the real device.
+ */
+
 // =========================================================================
 // SECTION: UART Output Redirection (for printf or LOG)
 // =========================================================================
@@ -42,6 +107,7 @@
  *
  * We redirect all output to USART2 for UART communication.
  */
+#ifndef NATIVE
 int _write(int handle, char* data, int size) {
     int count = size;
 
@@ -58,6 +124,7 @@ int _write(int handle, char* data, int size) {
     // Return total number of bytes "written" (as expected by printf())
     return size;
 }
+#endif
 
 // =========================================================================
 // SECTION: FIFO Setup
@@ -165,7 +232,7 @@ typedef enum {
     MSG_HD_BOOM_XY,
     MSG_HD_BOOM_RESULT,
     MSG_HD_SF_ROW,
-    /* MSG_INVALID */   // could be added for error handling
+    MSG_INVALID     // unknown message or debug command (already handled in decoder)
 } MessageType;
 
 /* Enum for representing shot results */
@@ -194,6 +261,18 @@ typedef struct {
     uint8_t hunter_x;
     uint8_t hunter_y;
 
+    uint8_t fallback_x;     // precomputed shot, sent if the targeter misses the reply deadline
+    uint8_t fallback_y;
+
+    char deduced[FIELD_SIZE];   // enemy cells proven by logic: '0' unknown, 'W' water, 'S' ship
+    uint8_t ships_left[MAX_SHIP_LEN + 1];   // enemy ships not yet sunk, index = ship length
+
+    bool opponent_cheated;                  // their replies contradict every legal fleet
+    bool consist_pending;                   // a reply has not been checked yet (runs while the host is quiet)
+
+    uint8_t enemy_shot_count;               // shots the opponent fired so far
+    uint8_t enemy_opening[SHOT_ORDER_LEN];  // cell index of the opponent's first shots
+
     uint8_t parser_x;
     uint8_t parser_y;
     uint8_t parser_row;
@@ -205,6 +284,98 @@ typedef struct {
 /* Counter to detect how often the opponent cheated */
 int cheat_counter = 0;
 
+/*
+ * Variance of each fingerprint feature within the games of one opponent,
+ * measured in the arena (stupid, hunt, parity and density hosts, 500 games
+ * each, pooled). The spread between these opponents is of the same size, so
+ * one game only separates them with a threshold well above 1 (FP_MATCH_MAX).
+ */
+const float fp_within_var[FP_FEATURES] = { 0.45f, 2.56f, 1.99f, 1.84f };
+
+/**
+ * @brief Learned model of one opponent.
+ *
+ * HD_START carries no identity, so opponents are recognised by a fingerprint
+ * of their opening shots and their checksum. Per opponent we learn which
+ * cells they fire at early (shot-order model) and place our fleet away from them.
+ */
+typedef struct {
+    bool used;
+    uint8_t games;                      // games seen (halved at FP_MAX_GAMES)
+    uint16_t last_used;                 // for replacing the least recently used profile
+    uint16_t feature_sum[FP_FEATURES];  // sum of fingerprints, mean = feature_sum / games
+    uint8_t shot_order[FIELD_SIZE];     // how often they fired at the cell within their first shots
+#if USE_FP_PRIOR
+    uint8_t ship_prior[FIELD_SIZE];     // how often one of their ships covered the cell
+#endif
+} OpponentProfile;
+
+OpponentProfile profiles[MAX_PROFILES];
+
+/* Profile of the current (or, before classification, the last) opponent, -1 = none */
+int8_t active_profile = -1;
+uint16_t profile_clock = 0;
+
+/* Set by the deadline timer interrupt, polled by the targeter to stop cooperatively */
+volatile bool deadline_expired = false;
+
+/* Counter how often our shot had to be replaced by the fallback shot */
+int deadline_misses = 0;
+
+/**
+ * @brief Partial enemy fleet built by the consistency check (check_consistency).
+ */
+typedef struct {
+    uint8_t ship[FIELD_SIZE];       // 1 = covered by a placed ship
+    uint8_t blocked[FIELD_SIZE];    // placed ships touching the cell (incl. diagonals)
+    uint8_t row_cnt[ROWS];          // ship parts placed per row
+    uint8_t left[MAX_SHIP_LEN + 1]; // ships still to place, index = ship length
+    uint8_t placed;
+    uint16_t nodes;                 // nodes visited in this check (all attempts)
+    uint16_t budget;                // node limit of the running attempt
+    uint8_t attempt;                // attempts started in this check
+    uint32_t ticks;                 // time spent in this check (all runs)
+} FleetSearch;
+
+FleetSearch fleet_search;
+
+/* Last fleet found, reused as long as the replies agree with it (witness_cs: checksum it was found for) */
+uint8_t fleet_witness[FIELD_SIZE];
+uint8_t witness_cs[ROWS];
+
+/* Statistics of the consistency check (DD_EVALUATE_CONSIST) */
+uint32_t consist_checks = 0;
+uint32_t consist_nodes = 0;
+uint16_t consist_max_nodes = 0;
+uint32_t consist_budget_hits = 0;
+uint32_t consist_interrupts = 0;    // runs stopped because the host started sending
+uint32_t consist_ticks = 0;
+uint32_t consist_max_ticks = 0;
+int cheats_detected = 0;
+
+/* Set while the parser holds part of a message, i.e. the host is sending */
+bool rx_in_progress = false;
+
+/**
+ * @brief Snapshot of what the targeter knows about the enemy field (debug only).
+ *
+ * Sent as ROWS lines "DH_#HM_{row}_{scores}_{states}" and a closing line
+ * "DH_#HM_L_{ships of length 2..5 left}_{max. score}". Scores are 0..9
+ * (scaled to the max.), states are '.' unknown, 'W' proven water,
+ * 'S' forced ship, 'H' hit and 'M' miss.
+ */
+typedef struct {
+    char score[FIELD_SIZE];
+    char state[FIELD_SIZE];
+    uint8_t ships_left[MAX_SHIP_LEN + 1];
+    uint32_t max_score;
+} Heatmap;
+
+Heatmap heatmap;
+bool heatmap_stream = HEATMAP_STREAM;
+uint8_t heatmap_line = ROWS + 1;    // next line of the deferred stream, > ROWS = nothing pending
+bool heatmap_pending = false;       // a shot result arrived, take a snapshot once the host is quiet
+
 // =========================================================================
 // SECTION: State Machine Setup
 // =========================================================================
@@ -216,6 +387,7 @@ void state_end(MessageBuffer*, GameState*);
 
 /* Resets game state and prepares for a new match */
 void init_new_game(MessageBuffer*, GameState*);
+void restart_game(MessageBuffer*, GameState*);
 
 /* Enum for FSM states */
 typedef enum {STATE_INIT, STATE_PLAY, STATE_END} State_Type;
@@ -241,6 +413,20 @@ static State_Type curr_state;
 void fifo_parser(MessageBuffer*);
 MessageType message_decoder(MessageBuffer*, GameState*);
 
+#ifdef NATIVE
+/* Host stand-in for the USART2 RX interrupt */
+void native_usart_poll(void);
+#endif
+
+/* Reply Deadline */
+void deadline_init(void);
+void deadline_arm(void);
+void deadline_disarm(void);
+void ticks_init(void);
+uint32_t ticks_now(void);
+bool host_sending(void);
+bool host_quiet(MessageBuffer*);
+
 /* Message Handlers */
 void handle_hd_start(GameState*);
 void handle_hd_cs(GameState*);
@@ -252,15 +438,59 @@ void handle_hd_sf_row(MessageBuffer*, GameState*);
 void print_my_field(GameState*);
 void place_ship_and_blocked(GameState*, uint8_t, uint8_t, bool);
 bool try_place_ship(GameState*, uint8_t);
+void place_fleet(GameState*);
+void update_my_checksum(GameState*);
+uint16_t checksum_leakage(GameState*);
 void create_my_field(GameState*);
-void attacking_opponent(GameState*);
+void fire_shot(GameState*, uint8_t, uint8_t);
+void update_fallback_shot(GameState*);
+bool attacking_opponent(GameState*);
 bool validate_enemy_cs(GameState*);
 
+/* Constraint Propagation */
+bool cell_is_ship(GameState*, uint8_t);
+bool cell_is_water(GameState*, uint8_t);
+bool mark_cell(GameState*, uint8_t, char);
+void count_ships_left(GameState*);
+bool deduce_no_touch(GameState*);
+bool deduce_row_budget(GameState*);
+bool deduce_runs(GameState*);
+bool deduce_fit(GameState*);
+void deduce(GameState*);
+
+/* Consistency Check */
+bool placement_fits(GameState*, FleetSearch*, uint8_t, uint8_t, bool);
+void placement_set(FleetSearch*, uint8_t, uint8_t, bool, int8_t);
+bool fleet_feasible(GameState*, FleetSearch*, uint8_t);
+int8_t fleet_search_step(GameState*, FleetSearch*, uint8_t);
+void request_consistency_check(GameState*);
+void check_consistency(GameState*);
+void consist_deferred(MessageBuffer*, GameState*);
+
+/* Opponent Fingerprinting */
+void fingerprint(GameState*, uint8_t*);
+int8_t new_profile(void);
+void classify_opponent(GameState*);
+void learn_opponent(GameState*);
+uint8_t cell_prior(uint8_t);
+
+/* Targeting Heatmap */
+void heatmap_snapshot(GameState*);
+void heatmap_print_line(uint8_t);
+void debug_deferred(MessageBuffer*, GameState*);
+
 // =========================================================================
 // SECTION: Main()
 // =========================================================================
 
 int main(void) {
+#ifdef NATIVE
+    /* stdout is the "UART": flush every line, seed rand() so parallel instances differ */
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    if (getenv("BATTLESHIP_SEED") != NULL) {
+        srand(atoi(getenv("BATTLESHIP_SEED")));
+    }
+#else
     /* Configure system clock (48 MHz) */
     SystemClock_Config();
 
@@ -292,6 +522,11 @@ int main(void) {
     uint32_t uart_pri_encoding = NVIC_EncodePriority(0, 1, 0);
     NVIC_SetPriority(USART2_IRQn, uart_pri_encoding);
     NVIC_EnableIRQ(USART2_IRQn);
+#endif
+
+    /* Reply deadline timer (TIM6) and tick counter (SysTick) */
+    deadline_init();
+    ticks_init();
 
     /* Software Structures*/
     fifo_init((Fifo_t *)&usart_rx_fifo);
@@ -302,8 +537,13 @@ int main(void) {
 
     /* Main Program Loop (Finite State Machine) */
     while (1) {
+#ifdef NATIVE
+        native_usart_poll();        // receive bytes from host (replaces RX interrupt)
+#endif
         fifo_parser(&usart_msg);    // parse complete UART message from FIFO
         state_table[curr_state](&usart_msg, &game); // call current FSM state handler
+        consist_deferred(&usart_msg, &game); // check the last reply while the host is quiet
+        debug_deferred(&usart_msg, &game); // send pending debug output while the host is quiet
     }
 
     return 0;
@@ -313,6 +553,44 @@ int main(void) {
 // SECTION: Interrupt Handler
 // =========================================================================
 
+#ifdef NATIVE
+/**
+ * @brief Host stand-in for the USART2 RX interrupt (native build only).
+ *
+ * Waits up to 1 ms for input on stdin and moves the received bytes into the
+ * receive FIFO. Only as many bytes as fit into the FIFO are read, the rest
+ * stays queued in the pty (like bytes still "on the wire").
+ * Terminates the program once the host closed the connection and all
+ * received bytes have been handled.
+ */
+void native_usart_poll(void) {
+    struct pollfd pfd = { .fd = STDIN_FILENO, .events = POLLIN };
+    uint8_t chunk[BUFFER_SIZE];
+    uint16_t used = (usart_rx_fifo.head + BUFFER_SIZE - usart_rx_fifo.tail) % BUFFER_SIZE;
+    uint16_t space = BUFFER_SIZE - 1 - used;
+
+    if (space == 0 || poll(&pfd, 1, 1) <= 0) return;
+
+    ssize_t n = read(STDIN_FILENO, chunk, space);
+    if (n < 0 && errno == EINTR) return;    // interrupted by the deadline "timer"
+    if (n <= 0) {
+        if (fifo_is_empty((Fifo_t *)&usart_rx_fifo)) exit(0);   // host is gone, all input handled
+        return;
+    }
+
+    for (ssize_t i = 0; i < n; i++) {
+        fifo_put((Fifo_t *)&usart_rx_fifo, chunk[i]);
+    }
+}
+
+/**
+ * @brief Host stand-in for the TIM6 interrupt (native build only).
+ */
+void native_deadline_handler(int signum) {
+    (void)signum;
+    deadline_expired = true;
+}
+#else
 void USART2_IRQHandler(void) {
     if (USART2->ISR & USART_ISR_RXNE) {
         uint8_t c = USART2->RDR;
@@ -320,6 +598,121 @@ void USART2_IRQHandler(void) {
     }
 }
 
+/**
+ * @brief TIM6 update interrupt: the reply deadline has passed.
+ */
+void TIM6_DAC_IRQHandler(void) {
+    if (TIM6->SR & TIM_SR_UIF) {
+        TIM6->SR &= ~TIM_SR_UIF;
+        deadline_expired = true;
+    }
+}
+#endif
+
+// =========================================================================
+// SECTION: Reply Deadline
+// =========================================================================
+
+/**
+ * @brief Configures TIM6 as one-shot timer for the reply deadline.
+ *
+ * The timer counts in 1 ms steps and stops itself after REPLY_DEADLINE_MS
+ * (one-pulse mode), raising the update interrupt which sets deadline_expired.
+ * The native build uses setitimer()/SIGALRM instead.
+ */
+void deadline_init(void) {
+#ifdef NATIVE
+    signal(SIGALRM, native_deadline_handler);
+#else
+    RCC->APB1ENR |= RCC_APB1ENR_TIM6EN;
+
+    TIM6->PSC = (APB_FREQ / 1000) - 1;  // 48 MHz / 48000 = 1 kHz -> 1 ms per tick
+    TIM6->ARR = REPLY_DEADLINE_MS - 1;
+    TIM6->CR1 |= TIM_CR1_OPM;           // one-pulse mode: counter stops at update event
+    TIM6->EGR = TIM_EGR_UG;             // load prescaler now
+    TIM6->SR = 0;                       // UG also sets UIF, clear it
+    TIM6->DIER |= TIM_DIER_UIE;         // enable update interrupt
+
+    uint32_t tim_pri_encoding = NVIC_EncodePriority(0, 2, 0);
+    NVIC_SetPriority(TIM6_DAC_IRQn, tim_pri_encoding);
+    NVIC_EnableIRQ(TIM6_DAC_IRQn);
+#endif
+}
+
+/**
+ * @brief Starts the deadline (called when HD_BOOM_x_y is decoded).
+ */
+void deadline_arm(void) {
+    deadline_expired = false;
+#ifdef NATIVE
+    struct itimerval t = { .it_value = { .tv_sec = REPLY_DEADLINE_MS / 1000,
+                                         .tv_usec = (REPLY_DEADLINE_MS % 1000) * 1000 } };
+    setitimer(ITIMER_REAL, &t, NULL);
+#else
+    TIM6->CNT = 0;
+    TIM6->CR1 |= TIM_CR1_CEN;
+#endif
+}
+
+/**
+ * @brief Stops the deadline once our shot has been committed.
+ */
+void deadline_disarm(void) {
+#ifdef NATIVE
+    struct itimerval t = { 0 };
+    setitimer(ITIMER_REAL, &t, NULL);
+#else
+    TIM6->CR1 &= ~TIM_CR1_CEN;
+    TIM6->SR &= ~TIM_SR_UIF;
+#endif
+}
+
+/**
+ * @brief Starts SysTick as free-running 24 bit down-counter at the core
+ * clock (no interrupt), used to time the background work in ticks.
+ */
+void ticks_init(void) {
+#ifndef NATIVE
+    SysTick->LOAD = TICK_MASK;
+    SysTick->VAL = 0;
+    SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_ENABLE_Msk;
+#endif
+}
+
+/**
+ * @brief Current tick count (TICKS_PER_US per microsecond, wraps at TICK_MASK).
+ * Durations are (end - start) & TICK_MASK.
+ */
+uint32_t ticks_now(void) {
+#ifdef NATIVE
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint32_t)(((uint64_t)t.tv_sec * 1000000000ULL + t.tv_nsec) * TICKS_PER_US / 1000) & TICK_MASK;
+#else
+    return TICK_MASK - SysTick->VAL;    // SysTick counts down
+#endif
+}
+
+/**
+ * @brief True while the host is sending: a message is being received or
+ * bytes wait in the receive FIFO (native: in the pty).
+ */
+bool host_sending(void) {
+    if (rx_in_progress || !fifo_is_empty((Fifo_t *)&usart_rx_fifo)) return true;
+#ifdef NATIVE
+    struct pollfd pfd = { .fd = STDIN_FILENO, .events = POLLIN };
+    if (poll(&pfd, 1, 0) > 0) return true;  // bytes still in the pty are "on the wire"
+#endif
+    return false;
+}
+
+/**
+ * @brief True while no host message is being received or waiting to be handled.
+ */
+bool host_quiet(MessageBuffer* msg) {
+    return !msg->ready && !host_sending();
+}
+
 // =========================================================================
 // SECTION: Parser
 // =========================================================================
@@ -348,6 +741,7 @@ void fifo_parser(MessageBuffer* msg)
                 msg->ready = true;                          // mark message as ready
                 memset(temp_msg_buffer, 0, BUFFER_SIZE);    // clear temp buffer
                 index = 0;
+                rx_in_progress = false;
                 return;
             }
             if (index < BUFFER_SIZE - 1) {
@@ -357,6 +751,7 @@ void fifo_parser(MessageBuffer* msg)
             }
         }
     }
+    rx_in_progress = index > 0;
 }
 
 /**
@@ -397,13 +792,14 @@ MessageType message_decoder(MessageBuffer* msg, GameState* game)
 
         game->parser_x = msg->buffer[8] - '0';
         game->parser_y = msg->buffer[10] - '0';
+        deadline_arm();     // our shot has to leave within REPLY_DEADLINE_MS from now
         return MSG_HD_BOOM_XY;
     }
 
     /* HD_BOOM_{H/M} */
     if (strncmp(msg->buffer, "HD_BOOM_", 8) == 0 && strlen(msg->buffer) == 9 &&
         (msg->buffer[8] == 'H' || msg->buffer[8] == 'M')) {
-        if (msg->buffer[8] == "H") {
+        if (msg->buffer[8] == 'H') {
             game->last_shot_result = HIT;
         } else {
             game->last_shot_result = MISS;
@@ -436,8 +832,67 @@ MessageType message_decoder(MessageBuffer* msg, GameState* game)
         LOG("Reset of Cheat-Counter was successfull!\r\n");
     }
 
+    /* Count how often the reply deadline was missed (fallback shot sent) */
+    if (strcmp(msg->buffer, "DD_EVALUATE_DL") == 0) {
+        LOG("Reply deadline missed %d times!\r\n", deadline_misses);
+    }
+
+    /* Show which opponent profile is active */
+    if (strcmp(msg->buffer, "DD_EVALUATE_FP") == 0) {
+        LOG("Opponent profile %d, %d games seen\r\n", active_profile,
+            active_profile >= 0 ? profiles[active_profile].games : 0);
+    }
+
+    /* Statistics of the live consistency check */
+    if (strcmp(msg->buffer, "DD_EVALUATE_CONSIST") == 0) {
+        LOG("Consistency checks %lu, nodes mean %lu max %u, budget exhausted %lu, interrupted %lu, cheats detected %d",
+            (unsigned long)consist_checks, (unsigned long)(consist_checks ? consist_nodes / consist_checks : 0),
+            consist_max_nodes, (unsigned long)consist_budget_hits, (unsigned long)consist_interrupts, cheats_detected);
+        LOG(", time mean %lu us max %lu us\r\n",
+            (unsigned long)(consist_checks ? consist_ticks / consist_checks / TICKS_PER_US : 0),
+            (unsigned long)(consist_max_ticks / TICKS_PER_US));
+    }
+
+    if (strcmp(msg->buffer, "DD_RESET_CONSIST") == 0) {
+        consist_checks = 0;
+        consist_nodes = 0;
+        consist_max_nodes = 0;
+        consist_budget_hits = 0;
+        consist_interrupts = 0;
+        consist_ticks = 0;
+        consist_max_ticks = 0;
+        cheats_detected = 0;
+        LOG("Reset of Consistency-Statistics was successfull!\r\n");
+    }
+
+    /* Dump the targeting heatmap now */
+    if (strcmp(msg->buffer, "DD_HEATMAP") == 0) {
+        heatmap_snapshot(game);
+        for (uint8_t line = 0; line <= ROWS; line++) heatmap_print_line(line);
+        heatmap_line = ROWS + 1;
+    }
+
+    /* Stream the targeting heatmap after each of our shots (deferred, see debug_deferred) */
+    if (strcmp(msg->buffer, "DD_HEATMAP_ON") == 0) {
+        heatmap_stream = true;
+        LOG("Heatmap stream on\r\n");
+    }
+
+    if (strcmp(msg->buffer, "DD_HEATMAP_OFF") == 0) {
+        heatmap_stream = false;
+        heatmap_pending = false;
+        heatmap_line = ROWS + 1;
+        LOG("Heatmap stream off\r\n");
+    }
+
+    /* Reset deadline miss counter */
+    if (strcmp(msg->buffer, "DD_RESET_DL") == 0) {
+        deadline_misses = 0;
+        LOG("Reset of Deadline-Counter was successfull!\r\n");
+    }
+
     /* Unknown or unsupportd message */
-    // return MSG_INVALID;
+    return MSG_INVALID;
 }
 
 // =========================================================================
@@ -483,6 +938,14 @@ void state_play(MessageBuffer* msg, GameState* game) {
 
     MessageType type = message_decoder(msg, game);
 
+    if (CHEAT_END_GAME && game->opponent_cheated && type != MSG_HD_START) {
+        /* stop playing, announced instead of the reply, the host has to start a new game */
+        LOG("DH_#END game dropped, opponent cheated, waiting for HD_START\r\n");
+        init_new_game(msg, game);
+        curr_state = STATE_INIT;
+        return;
+    }
+
     if (type == MSG_HD_BOOM_XY) {
         handle_hd_boom_xy(game);
         if (game->i_lost) {
@@ -500,6 +963,8 @@ void state_play(MessageBuffer* msg, GameState* game) {
         } else {
             curr_state = STATE_PLAY;
         }
+    } else if (type == MSG_HD_START) {
+        restart_game(msg, game);        // host aborted the running game and starts a new one
     }
 
     msg->ready = false;
@@ -511,6 +976,7 @@ void state_play(MessageBuffer* msg, GameState* game) {
  * If we lost, the function waits for the opponent's field rows (HD_SF),
  * then verifies their checksum. If cheating is detected, a counter is incremented.
  * If we won, our field is printed and a new game is initialized.
+ * Either way the opponent's profile learns from the finished game first.
  */
 void state_end(MessageBuffer* msg, GameState* game) {
     if (game->i_lost) {
@@ -522,23 +988,40 @@ void state_end(MessageBuffer* msg, GameState* game) {
             handle_hd_sf_row(msg, game);
 
             if (game->last_row) {
-                if (validate_enemy_cs(game)) {
-                    /* handle Cheating here */
+                if (!validate_enemy_cs(game) && !game->opponent_cheated) {
+                    /* handle Cheating here (once per game, the consistency check may have counted it already) */
+                    game->opponent_cheated = true;
                     cheat_counter++;
                 }
+                learn_opponent(game);
                 init_new_game(msg, game);
                 curr_state = STATE_INIT;
             }
+        } else if (type == MSG_HD_START) {
+            restart_game(msg, game);    // host aborted the running game and starts a new one
         }
 
         msg->ready = false;
     } else {
         print_my_field(game);
+        learn_opponent(game);
         init_new_game(msg, game);
         curr_state = STATE_INIT;
     }
 }
 
+/**
+ * @brief Starts over when the host sends HD_START in the middle of a game.
+ *
+ * The host aborts a game on protocol errors and simply starts the next one,
+ * so the device has to answer the handshake from any state.
+ */
+void restart_game(MessageBuffer* msg, GameState* game) {
+    init_new_game(msg, game);
+    handle_hd_start(game);
+    curr_state = STATE_INIT;
+}
+
 /**
  * @brief Resets the game state and message buffer for a new match.
  *
@@ -555,6 +1038,13 @@ void init_new_game(MessageBuffer* msg, GameState* game) {
     memset(game->enemy_field, '0', FIELD_SIZE);
     memset(game->my_shots, '0', FIELD_SIZE);
     memset(game->enemy_shots, '0', FIELD_SIZE);
+    memset(game->deduced, '0', FIELD_SIZE);
+    count_ships_left(game);
+    game->opponent_cheated = false;
+    game->consist_pending = false;
+
+    game->enemy_shot_count = 0;
+    memset(game->enemy_opening, 0, SHOT_ORDER_LEN);
 
     memset(game->my_checksum, 0, ROWS);
     memset(game->enemy_checksum, 0, ROWS);
@@ -568,6 +1058,8 @@ void init_new_game(MessageBuffer* msg, GameState* game) {
     game->hunter_x = 0;
     game->hunter_y = 0;
 
+    update_fallback_shot(game);
+
     game->parser_x = 0;
     game->parser_y = 0;
     game->parser_row = 0;
@@ -600,6 +1092,11 @@ void handle_hd_cs(GameState* game) {
         LOG("%d", game->my_checksum[i]);
     }
     LOG("\r\n");
+
+    /* empty rows are known now */
+    deduce(game);
+    update_fallback_shot(game);
+    request_consistency_check(game);
 }
 
 /**
@@ -611,6 +1108,13 @@ void handle_hd_boom_xy(GameState* game) {
     uint8_t y = game->parser_y;
     uint8_t index = IDX(x, y);
 
+    if (game->enemy_shot_count < SHOT_ORDER_LEN) {
+        game->enemy_opening[game->enemy_shot_count] = index;
+    }
+    if (game->enemy_shot_count < 255) {
+        game->enemy_shot_count++;
+    }
+
     if (game->my_field[index] == '0') {
         LOG("DH_BOOM_M\r\n");
         if (game->enemy_shots[index] != 'M') {
@@ -632,7 +1136,16 @@ void handle_hd_boom_xy(GameState* game) {
         LOG("DH_BOOM_H\r\n");
     }
 
-    attacking_opponent(game);
+    if (!attacking_opponent(game)) {
+        /* targeter was stopped by the deadline or found nothing: send the precomputed shot instead */
+        if (deadline_expired) deadline_misses++;
+        fire_shot(game, game->fallback_x, game->fallback_y);
+    }
+
+    /* after our reply: once the opening is complete, find out who we are playing */
+    if (game->enemy_shot_count == OPENING_LEN) {
+        classify_opponent(game);
+    }
 }
 
 /**
@@ -652,6 +1165,14 @@ void handle_hd_boom_result(GameState* game) {
     } else if (game->last_shot_result == MISS) {
         game->my_shots[index] = 'M';
     }
+
+    /* propagate what we learned and prepare the fallback shot, while the host is busy */
+    deduce(game);
+    update_fallback_shot(game);
+    request_consistency_check(game);
+
+    /* queue the heatmap, it is taken and sent once the host is quiet (see debug_deferred) */
+    if (heatmap_stream) heatmap_pending = true;
 }
 
 /**
@@ -821,7 +1342,10 @@ bool try_place_ship(GameState* game, uint8_t size) {
     return false;
 }
 
-void create_my_field(GameState* game) {
+/**
+ * @brief Places the whole fleet randomly into my_field (no checksum yet).
+ */
+void place_fleet(GameState* game) {
     memset(game->my_field, '0', FIELD_SIZE);  // clear field
 
     uint8_t n_battleship = 1;
@@ -839,18 +1363,12 @@ void create_my_field(GameState* game) {
     for (uint8_t i = 0; i < FIELD_SIZE; i++) {
         if (game->my_field[i] == 'X') game->my_field[i] = '0';
     }
+}
 
-    // count ship parts (should be exactly 30)
-    uint8_t count = 0;
-    for (uint8_t i = 0; i < FIELD_SIZE; i++) {
-        if (game->my_field[i] >= '2' && game->my_field[i] <= '5') count++;
-    }
-
-    if (count != 30) {
-        // optional: error handling or regenerate field
-    }
-
-    // calculate checksum for each row
+/**
+ * @brief Calculates the checksum (ship parts) of each row of my_field.
+ */
+void update_my_checksum(GameState* game) {
     for (uint8_t row = 0; row < ROWS; row++) {
         uint8_t cs = 0;
         for (uint8_t col = 0; col < COLS; col++) {
@@ -861,41 +1379,144 @@ void create_my_field(GameState* game) {
     }
 }
 
-void attacking_opponent(GameState *game) {
+/**
+ * @brief How much our row checksums give away: squared deviation from an
+ * even spread (3 parts per row). Empty rows are free water for the opponent,
+ * dense rows tell a row-aware opponent where to aim.
+ */
+uint16_t checksum_leakage(GameState* game) {
+    uint16_t leakage = 0;
+    for (uint8_t row = 0; row < ROWS; row++) {
+        int8_t d = game->my_checksum[row] - 3;
+        leakage += d * d;
+    }
+    return leakage;
+}
+
+/**
+ * @brief Generates our field and its row checksums.
+ *
+ * Up to LAYOUT_TRIES complete fleets are generated. With USE_CS_SPREAD the
+ * field is taken from the class whose checksum leakage is at most
+ * CS_SPREAD_MAX (the least leaking one if none is), against a recognised
+ * opponent the one least exposed to the cells it fires at early; otherwise
+ * the first one wins, so the choice stays random within the class.
+ */
+void create_my_field(GameState* game) {
+    char best_field[FIELD_SIZE];
+    uint16_t best_leakage = 0xFFFF;
+    uint16_t best_exposure = 0xFFFF;
+
+    for (uint8_t t = 0; t < LAYOUT_TRIES; t++) {
+        place_fleet(game);
+
+        // count ship parts (must be exactly 30, otherwise regenerate)
+        uint8_t count = 0;
+        for (uint8_t i = 0; i < FIELD_SIZE; i++) {
+            if (game->my_field[i] >= '2' && game->my_field[i] <= '5') count++;
+        }
+        if (count != 30) continue;
+
+        update_my_checksum(game);
+
+        uint16_t leakage = 0;
+#if USE_CS_SPREAD
+        leakage = checksum_leakage(game);
+        leakage = leakage > CS_SPREAD_MAX ? leakage - CS_SPREAD_MAX : 0;
+#endif
+        uint16_t exposure = 0;
+#if USE_FINGERPRINT
+        if (active_profile >= 0) {
+            for (uint8_t i = 0; i < FIELD_SIZE; i++) {
+                if (game->my_field[i] != '0') exposure += profiles[active_profile].shot_order[i];
+            }
+        }
+#endif
+
+        if (leakage < best_leakage || (leakage == best_leakage && exposure < best_exposure)) {
+            best_leakage = leakage;
+            best_exposure = exposure;
+            memcpy(best_field, game->my_field, FIELD_SIZE);
+        }
+
+        // nothing left to choose by
+        if (leakage == 0 && (!USE_FINGERPRINT || active_profile < 0)) break;
+    }
+
+    // all fleets incomplete (very unlikely): keep the last one
+    if (best_leakage != 0xFFFF) memcpy(game->my_field, best_field, FIELD_SIZE);
+    update_my_checksum(game);
+}
+
+/**
+ * @brief Commits our shot: stops the reply deadline and sends DH_BOOM_x_y.
+ */
+void fire_shot(GameState* game, uint8_t x, uint8_t y) {
+    deadline_disarm();
+    game->last_shot_x = x;
+    game->last_shot_y = y;
+    LOG("DH_BOOM_%d_%d\r\n", x, y);
+}
+
+/**
+ * @brief Precomputes the fallback shot: the next untried cell of the
+ * checkerboard (every ship covers one), or any untried cell.
+ * Cells proven to be water are skipped, unless nothing else is left
+ * (a lying opponent can make every untried cell look like water).
+ */
+void update_fallback_shot(GameState* game) {
+    for (uint8_t pass = 0; pass < 3; pass++) {
+        for (uint8_t i = 0; i < FIELD_SIZE; i++) {
+            if (pass == 0 && (i / 10 + i % 10) % 2 != 0) continue;
+            if (game->my_shots[i] == '0' && (pass == 2 || game->deduced[i] != 'W')) {
+                game->fallback_x = i / 10;
+                game->fallback_y = i % 10;
+                return;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Chooses and fires our next shot.
+ * @return false if the reply deadline expired before a shot was committed
+ */
+bool attacking_opponent(GameState *game) {
+    // cells proven to be ship come first
+    for (uint8_t i = 0; i < FIELD_SIZE; i++) {
+        if (deadline_expired) return false;
+        if (game->deduced[i] == 'S' && game->my_shots[i] == '0') {
+            fire_shot(game, i / 10, i % 10);
+            return true;
+        }
+    }
+
     if (game->hunter_mode) {
         uint8_t x = game->hunter_x;
         uint8_t y = game->hunter_y;
 
         // try right
-        if (y + 1 < 10 && game->my_shots[IDX(x, y + 1)] == '0') {
-            game->last_shot_x = x;
-            game->last_shot_y = y + 1;
-            LOG("DH_BOOM_%d_%d\r\n", x, y + 1);
-            return;
+        if (y + 1 < 10 && game->my_shots[IDX(x, y + 1)] == '0' && game->deduced[IDX(x, y + 1)] != 'W') {
+            fire_shot(game, x, y + 1);
+            return true;
         }
 
         // try left
-        if (y > 0 && game->my_shots[IDX(x, y - 1)] == '0') {
-            game->last_shot_x = x;
-            game->last_shot_y = y - 1;
-            LOG("DH_BOOM_%d_%d\r\n", x, y - 1);
-            return;
+        if (y > 0 && game->my_shots[IDX(x, y - 1)] == '0' && game->deduced[IDX(x, y - 1)] != 'W') {
+            fire_shot(game, x, y - 1);
+            return true;
         }
 
         // try down
-        if (x + 1 < 10 && game->my_shots[IDX(x + 1, y)] == '0') {
-            game->last_shot_x = x + 1;
-            game->last_shot_y = y;
-            LOG("DH_BOOM_%d_%d\r\n", x + 1, y);
-            return;
+        if (x + 1 < 10 && game->my_shots[IDX(x + 1, y)] == '0' && game->deduced[IDX(x + 1, y)] != 'W') {
+            fire_shot(game, x + 1, y);
+            return true;
         }
 
         // try up
-        if (x > 0 && game->my_shots[IDX(x - 1, y)] == '0') {
-            game->last_shot_x = x - 1;
-            game->last_shot_y = y;
-            LOG("DH_BOOM_%d_%d\r\n", x - 1, y);
-            return;
+        if (x > 0 && game->my_shots[IDX(x - 1, y)] == '0' && game->deduced[IDX(x - 1, y)] != 'W') {
+            fire_shot(game, x - 1, y);
+            return true;
         }
 
         // no adjacent untried fields → end hunt
@@ -913,28 +1534,34 @@ void attacking_opponent(GameState *game) {
         }
     }
 
-    // fire in checkerboard pattern
+    // fire in checkerboard pattern (where the opponent placed ships most often first)
+    int16_t best = -1;
     for (uint8_t col = 0; col < COLS; col++) {
+        if (deadline_expired) return false;
         if ((best_row + col) % 2 != 0) continue;
 
         uint8_t idx = IDX(best_row, col);
-        if (game->my_shots[idx] == '0') {
-            game->last_shot_x = best_row;
-            game->last_shot_y = col;
-            LOG("DH_BOOM_%d_%d\r\n", best_row, col);
-            return;
+        if (game->my_shots[idx] == '0' && game->deduced[idx] != 'W' &&
+            (best < 0 || cell_prior(idx) > cell_prior(best))) {
+            best = idx;
         }
     }
 
-    // fallback: any untried field
-    for (uint8_t i = 0; i < FIELD_SIZE; i++) {
-        if (game->my_shots[i] == '0') {
-            game->last_shot_x = i / 10;
-            game->last_shot_y = i % 10;
-            LOG("DH_BOOM_%d_%d\r\n", game->last_shot_x, game->last_shot_y);
-            return;
+    // fallback: any untried field that may still hold a ship
+    if (best < 0) {
+        for (uint8_t i = 0; i < FIELD_SIZE; i++) {
+            if (deadline_expired) return false;
+            if (game->my_shots[i] == '0' && game->deduced[i] != 'W' &&
+                (best < 0 || cell_prior(i) > cell_prior(best))) {
+                best = i;
+            }
         }
     }
+
+    if (best < 0) return false;
+
+    fire_shot(game, best / 10, best % 10);
+    return true;
 }
 
 bool validate_enemy_cs(GameState* game) {
@@ -960,4 +1587,731 @@ bool validate_enemy_cs(GameState* game) {
     }
 
     return true;
-}
\ No newline at end of file
+}
+
+// =========================================================================
+// SECTION: Constraint Propagation
+// =========================================================================
+
+/**
+ * @brief Deduction pass over our shot record (my_shots) and the opponent's
+ * row checksums.
+ *
+ * Cells that can be proven by logic alone are stored in game->deduced:
+ * 'W' = certainly water (never fired at), 'S' = certainly ship (fired at first).
+ * The rules are applied until nothing changes any more (fixed point), but
+ * at most DEDUCE_MAX_PASSES times, so the cost per turn is bounded.
+ *
+ * Rules:
+ * - no-touch: the diagonal neighbours of a ship cell are water
+ * - row budget: a row whose checksum is used up holds only water, a row that
+ *   needs all its remaining cells holds only ships
+ * - run length: a run of ship cells as long as the longest ship left is closed
+ *   by water at both ends, closed runs count as sunk ships
+ * - fit: a cell where the shortest ship left fits neither horizontally nor
+ *   vertically is water
+ */
+
+/* Returns true if the enemy cell is known to be (part of) a ship */
+bool cell_is_ship(GameState* game, uint8_t i) {
+    return game->my_shots[i] == 'H' || game->deduced[i] == 'S';
+}
+
+/* Returns true if the enemy cell is known to be water */
+bool cell_is_water(GameState* game, uint8_t i) {
+    return game->my_shots[i] == 'M' || game->deduced[i] == 'W';
+}
+
+/**
+ * @brief Marks an unknown cell as 'W' or 'S'.
+ * @return true if the cell was unknown before (something changed)
+ */
+bool mark_cell(GameState* game, uint8_t i, char what) {
+    if (cell_is_ship(game, i) || cell_is_water(game, i)) return false;
+    game->deduced[i] = what;
+    return true;
+}
+
+/**
+ * @brief Recounts the enemy ships not sunk yet.
+ *
+ * A straight run of ship cells is a sunk ship when it is closed by water
+ * (or the edge) on both ends.
+ */
+void count_ships_left(GameState* game) {
+    game->ships_left[0] = 0;
+    game->ships_left[1] = 0;
+    game->ships_left[2] = 4;
+    game->ships_left[3] = 3;
+    game->ships_left[4] = 2;
+    game->ships_left[5] = 1;
+
+    for (uint8_t x = 0; x < ROWS; x++) {
+        for (uint8_t y = 0; y < COLS; y++) {
+            // only look at the first (top/left) cell of a run
+            if (!cell_is_ship(game, IDX(x, y))) continue;
+            if (y > 0 && cell_is_ship(game, IDX(x, y - 1))) continue;
+            if (x > 0 && cell_is_ship(game, IDX(x - 1, y))) continue;
+
+            uint8_t len_h = 1;
+            while (y + len_h < COLS && cell_is_ship(game, IDX(x, y + len_h))) len_h++;
+            uint8_t len_v = 1;
+            while (x + len_v < ROWS && cell_is_ship(game, IDX(x + len_v, y))) len_v++;
+
+            bool closed;
+            uint8_t len;
+            if (len_h > 1) {
+                len = len_h;
+                closed = (y == 0 || cell_is_water(game, IDX(x, y - 1))) &&
+                         (y + len == COLS || cell_is_water(game, IDX(x, y + len)));
+            } else if (len_v > 1) {
+                len = len_v;
+                closed = (x == 0 || cell_is_water(game, IDX(x - 1, y))) &&
+                         (x + len == ROWS || cell_is_water(game, IDX(x + len, y)));
+            } else {
+                continue;   // single cell, direction still unknown
+            }
+
+            if (closed && len <= MAX_SHIP_LEN && game->ships_left[len] > 0) {
+                game->ships_left[len]--;
+            }
+        }
+    }
+}
+
+/* Rule: the diagonal neighbours of a ship cell are water (ships do not touch) */
+bool deduce_no_touch(GameState* game) {
+    bool changed = false;
+
+    for (uint8_t x = 0; x < ROWS; x++) {
+        for (uint8_t y = 0; y < COLS; y++) {
+            if (!cell_is_ship(game, IDX(x, y))) continue;
+            if (x > 0 && y > 0)                changed |= mark_cell(game, IDX(x - 1, y - 1), 'W');
+            if (x > 0 && y + 1 < COLS)         changed |= mark_cell(game, IDX(x - 1, y + 1), 'W');
+            if (x + 1 < ROWS && y > 0)         changed |= mark_cell(game, IDX(x + 1, y - 1), 'W');
+            if (x + 1 < ROWS && y + 1 < COLS)  changed |= mark_cell(game, IDX(x + 1, y + 1), 'W');
+        }
+    }
+
+    return changed;
+}
+
+/* Rule: row checksum used up -> rest is water, row needs every open cell -> rest is ship */
+bool deduce_row_budget(GameState* game) {
+    bool changed = false;
+
+    for (uint8_t x = 0; x < ROWS; x++) {
+        uint8_t ships = 0;
+        uint8_t unknown = 0;
+        for (uint8_t y = 0; y < COLS; y++) {
+            if (cell_is_ship(game, IDX(x, y))) ships++;
+            else if (!cell_is_water(game, IDX(x, y))) unknown++;
+        }
+
+        if (unknown == 0) continue;
+        if (ships >= game->enemy_checksum[x]) {
+            for (uint8_t y = 0; y < COLS; y++) changed |= mark_cell(game, IDX(x, y), 'W');
+        } else if (ships + unknown == game->enemy_checksum[x]) {
+            for (uint8_t y = 0; y < COLS; y++) changed |= mark_cell(game, IDX(x, y), 'S');
+        }
+    }
+
+    return changed;
+}
+
+/* Rule: a run as long as the longest ship left can not grow, close it with water */
+bool deduce_runs(GameState* game) {
+    bool changed = false;
+    uint8_t longest = 0;
+
+    for (uint8_t len = MAX_SHIP_LEN; len > 0; len--) {
+        if (game->ships_left[len] > 0) {
+            longest = len;
+            break;
+        }
+    }
+
+    for (uint8_t x = 0; x < ROWS; x++) {
+        for (uint8_t y = 0; y < COLS; y++) {
+            if (!cell_is_ship(game, IDX(x, y))) continue;
+
+            // horizontal run starting here
+            if (y == 0 || !cell_is_ship(game, IDX(x, y - 1))) {
+                uint8_t len = 1;
+                while (y + len < COLS && cell_is_ship(game, IDX(x, y + len))) len++;
+                if (len > 1 && len >= longest) {
+                    if (y > 0)            changed |= mark_cell(game, IDX(x, y - 1), 'W');
+                    if (y + len < COLS)   changed |= mark_cell(game, IDX(x, y + len), 'W');
+                }
+            }
+
+            // vertical run starting here
+            if (x == 0 || !cell_is_ship(game, IDX(x - 1, y))) {
+                uint8_t len = 1;
+                while (x + len < ROWS && cell_is_ship(game, IDX(x + len, y))) len++;
+                if (len > 1 && len >= longest) {
+                    if (x > 0)            changed |= mark_cell(game, IDX(x - 1, y), 'W');
+                    if (x + len < ROWS)   changed |= mark_cell(game, IDX(x + len, y), 'W');
+                }
+            }
+        }
+    }
+
+    return changed;
+}
+
+/* Rule: a cell where not even the shortest ship left fits is water */
+bool deduce_fit(GameState* game) {
+    bool changed = false;
+    uint8_t shortest = MAX_SHIP_LEN + 1;
+
+    for (uint8_t len = 2; len <= MAX_SHIP_LEN; len++) {
+        if (game->ships_left[len] > 0) {
+            shortest = len;
+            break;
+        }
+    }
+
+    for (uint8_t x = 0; x < ROWS; x++) {
+        for (uint8_t y = 0; y < COLS; y++) {
+            if (cell_is_ship(game, IDX(x, y)) || cell_is_water(game, IDX(x, y))) continue;
+
+            // length of the non-water segment through (x, y) in both directions
+            uint8_t h = 1;
+            for (int8_t c = y - 1; c >= 0 && !cell_is_water(game, IDX(x, c)); c--) h++;
+            for (uint8_t c = y + 1; c < COLS && !cell_is_water(game, IDX(x, c)); c++) h++;
+            uint8_t v = 1;
+            for (int8_t r = x - 1; r >= 0 && !cell_is_water(game, IDX(r, y)); r--) v++;
+            for (uint8_t r = x + 1; r < ROWS && !cell_is_water(game, IDX(r, y)); r++) v++;
+
+            if (h < shortest && v < shortest) {
+                changed |= mark_cell(game, IDX(x, y), 'W');
+            }
+        }
+    }
+
+    return changed;
+}
+
+/**
+ * @brief Runs all deduction rules until a fixed point (or DEDUCE_MAX_PASSES).
+ */
+void deduce(GameState* game) {
+#if USE_DEDUCTION
+    for (uint8_t pass = 0; pass < DEDUCE_MAX_PASSES; pass++) {
+        bool changed = false;
+
+        count_ships_left(game);
+        changed |= deduce_no_touch(game);
+        changed |= deduce_row_budget(game);
+        changed |= deduce_runs(game);
+        changed |= deduce_fit(game);
+
+        if (!changed) break;
+    }
+#endif
+    count_ships_left(game);
+}
+
+// =========================================================================
+// SECTION: Consistency Check
+// =========================================================================
+
+/**
+ * @brief Tests a ship placement for the fleet search: inside the field, not
+ * on a miss, not touching a placed ship, within the row checksums, and no
+ * hit next to it that it does not cover.
+ */
+bool placement_fits(GameState* game, FleetSearch* fs, uint8_t start, uint8_t len, bool horizontal) {
+    uint8_t x = start / 10;
+    uint8_t y = start % 10;
+    if (horizontal ? y + len > COLS : x + len > ROWS) return false;
+
+    if (horizontal && fs->row_cnt[x] + len > game->enemy_checksum[x]) return false;
+
+    for (uint8_t k = 0; k < len; k++) {
+        uint8_t r = horizontal ? x : x + k;
+        uint8_t i = horizontal ? IDX(x, y + k) : IDX(x + k, y);
+        if (fs->ship[i] || fs->blocked[i] || game->my_shots[i] == 'M') return false;
+        if (!horizontal && fs->row_cnt[r] + 1 > game->enemy_checksum[r]) return false;
+    }
+
+    // the surrounding ring must not hold a hit of another ship
+    int8_t x0 = x - 1, y0 = y - 1;
+    int8_t x1 = horizontal ? x + 1 : x + len;
+    int8_t y1 = horizontal ? y + len : y + 1;
+    for (int8_t r = x0; r <= x1; r++) {
+        for (int8_t c = y0; c <= y1; c++) {
+            if (r < 0 || r >= ROWS || c < 0 || c >= COLS) continue;
+            bool own = horizontal ? (r == x && c >= y && c < y + len) : (c == y && r >= x && r < x + len);
+            if (!own && game->my_shots[IDX(r, c)] == 'H') return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Places (dir = 1) or removes (dir = -1) a ship in the fleet search.
+ */
+void placement_set(FleetSearch* fs, uint8_t start, uint8_t len, bool horizontal, int8_t dir) {
+    uint8_t x = start / 10;
+    uint8_t y = start % 10;
+
+    int8_t x0 = x - 1, y0 = y - 1;
+    int8_t x1 = horizontal ? x + 1 : x + len;
+    int8_t y1 = horizontal ? y + len : y + 1;
+    for (int8_t r = x0; r <= x1; r++) {
+        for (int8_t c = y0; c <= y1; c++) {
+            if (r < 0 || r >= ROWS || c < 0 || c >= COLS) continue;
+            fs->blocked[IDX(r, c)] += dir;
+        }
+    }
+    for (uint8_t k = 0; k < len; k++) {
+        uint8_t r = horizontal ? x : x + k;
+        fs->ship[horizontal ? IDX(x, y + k) : IDX(x + k, y)] = dir > 0;
+        fs->row_cnt[r] += dir;
+    }
+    fs->left[len] -= dir;
+    fs->placed += dir;
+}
+
+/**
+ * @brief Cheap bound for the ships still to place, which all start at cell
+ * "from" or later: every row not passed yet can still reach its checksum and
+ * has room for its hits not covered yet (passed rows are final).
+ */
+bool fleet_feasible(GameState* game, FleetSearch* fs, uint8_t from) {
+    for (uint8_t row = from / 10; row < ROWS; row++) {
+        uint8_t need = game->enemy_checksum[row] - fs->row_cnt[row];
+        uint8_t room = 0;
+        uint8_t hits = 0;
+        for (uint8_t col = 0; col < COLS; col++) {
+            uint8_t i = IDX(row, col);
+            if (fs->ship[i]) continue;
+            if (game->my_shots[i] == 'H') hits++;
+            if (i >= from && !fs->blocked[i] && game->my_shots[i] != 'M') room++;
+        }
+        if (need > room || hits > need) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief One level of the fleet search (depth-first, one ship per level).
+ *
+ * Ships are placed by their top/left cell in field order, starting at cell
+ * "from". Skipping a cell makes it water, so an uncovered hit ends the level,
+ * and a row is final (must match its checksum) once the scan has passed it.
+ * Length and orientation are tried in a random rotation, so a restarted
+ * search does not get stuck in the same hopeless subtree.
+ * @return 1 fleet found, 0 no fleet, -1 budget exhausted, -2 the host started sending
+ */
+int8_t fleet_search_step(GameState* game, FleetSearch* fs, uint8_t from) {
+    if (host_sending()) return -2;
+    if (++fs->nodes > fs->budget) return -1;
+    if (!fleet_feasible(game, fs, from)) return 0;
+    if (fs->placed == FLEET_SHIPS) {
+        // rows are full (checksums sum up to the fleet size): remember the fleet
+        memcpy(fleet_witness, fs->ship, FIELD_SIZE);
+        memcpy(witness_cs, game->enemy_checksum, ROWS);
+        return 1;
+    }
+
+    for (uint8_t i = from; i < FIELD_SIZE; i++) {
+        uint8_t row = i / 10;
+        if (i % 10 == 0 && row > 0 && fs->row_cnt[row - 1] != game->enemy_checksum[row - 1]) return 0;
+        if (fs->ship[i] || fs->blocked[i] || game->my_shots[i] == 'M') continue;
+
+        uint8_t rot = rand();
+        for (uint8_t k = 0; k < 8; k++) {
+            uint8_t len = 2 + ((k + rot) & 3);
+            bool horizontal = ((k >> 2) + (rot >> 2)) & 1;
+            if (fs->left[len] == 0) continue;
+            if (!placement_fits(game, fs, i, len, horizontal)) continue;
+
+            placement_set(fs, i, len, horizontal, 1);
+            int8_t res = fleet_search_step(game, fs, i + 1);
+            placement_set(fs, i, len, horizontal, -1);
+            if (res != 0) return res;
+        }
+
+        if (game->my_shots[i] == 'H') return 0;     // a hit can not be water
+    }
+    return 0;
+}
+
+/**
+ * @brief Queues the consistency check after a reply (HD_CS, HD_BOOM_H/M).
+ *
+ * The check itself runs from the main loop while the host is quiet
+ * (consist_deferred), so it never delays our reply to the host's next shot.
+ */
+void request_consistency_check(GameState* game) {
+#if USE_CONSIST_CHECK
+    if (game->opponent_cheated) return;
+
+    game->consist_pending = true;
+    fleet_search.attempt = 0;
+    fleet_search.nodes = 0;
+    fleet_search.ticks = 0;
+    consist_checks++;
+#else
+    (void)game;
+#endif
+}
+
+/**
+ * @brief Checks that at least one legal fleet still explains all of the
+ * opponent's replies (hits, misses) and its row checksums.
+ *
+ * Flags the opponent on the first contradiction: cheat_counter and
+ * cheats_detected are incremented once per game and a DH_# comment is sent.
+ * The last fleet found is kept, so the search only runs when a reply
+ * contradicts it. The search makes up to CONSIST_ATTEMPTS attempts of
+ * CONSIST_MAX_NODES nodes each (one complete attempt is a proof either way);
+ * an exhausted budget does not flag anybody. An attempt stopped because the
+ * host started sending counts as exhausted, the check goes on with the next
+ * attempt once the host is quiet again.
+ */
+void check_consistency(GameState* game) {
+#if USE_CONSIST_CHECK
+    FleetSearch* fs = &fleet_search;
+    uint32_t t0 = ticks_now();
+    uint16_t nodes0 = fs->nodes;
+
+    bool witness_ok = memcmp(witness_cs, game->enemy_checksum, ROWS) == 0;
+    for (uint8_t i = 0; i < FIELD_SIZE && witness_ok; i++) {
+        if (game->my_shots[i] == 'H' && !fleet_witness[i]) witness_ok = false;
+        if (game->my_shots[i] == 'M' && fleet_witness[i]) witness_ok = false;
+    }
+
+    uint8_t sum = 0;
+    for (uint8_t row = 0; row < ROWS; row++) sum += game->enemy_checksum[row];
+
+    int8_t res = witness_ok ? 1 : sum == 30 ? -1 : 0;
+    while (res < 0 && fs->attempt < CONSIST_ATTEMPTS) {
+        // a stopped search unwinds completely, so only the field has to be set up
+        memset(fs->ship, 0, FIELD_SIZE);
+        memset(fs->blocked, 0, FIELD_SIZE);
+        memset(fs->row_cnt, 0, ROWS);
+        fs->left[2] = 4;
+        fs->left[3] = 3;
+        fs->left[4] = 2;
+        fs->left[5] = 1;
+        fs->placed = 0;
+
+        fs->attempt++;
+        fs->budget = fs->nodes + CONSIST_MAX_NODES;
+        res = fleet_search_step(game, fs, 0);
+        if (fs->nodes > fs->budget) fs->nodes = fs->budget;
+        if (res == -2) break;
+    }
+
+    uint32_t ticks = (ticks_now() - t0) & TICK_MASK;
+    fs->ticks += ticks;
+    consist_ticks += ticks;
+    consist_nodes += fs->nodes - nodes0;
+
+    if (res == -2 && fs->attempt < CONSIST_ATTEMPTS) {
+        consist_interrupts++;
+        return;     // still pending, go on after the reply
+    }
+
+    game->consist_pending = false;
+    if (fs->nodes > consist_max_nodes) consist_max_nodes = fs->nodes;
+    if (fs->ticks > consist_max_ticks) consist_max_ticks = fs->ticks;
+    if (res < 0) consist_budget_hits++;
+
+    if (res == 0) {
+        game->opponent_cheated = true;
+        cheat_counter++;
+        cheats_detected++;
+        LOG("DH_#CHEAT no legal fleet fits your replies\r\n");
+    }
+#else
+    (void)game;
+#endif
+}
+
+/**
+ * @brief Runs a pending consistency check while the host is quiet
+ * (called once per main loop iteration).
+ */
+void consist_deferred(MessageBuffer* msg, GameState* game) {
+    if (game->consist_pending && host_quiet(msg)) check_consistency(game);
+}
+
+// =========================================================================
+// SECTION: Opponent Fingerprinting
+// =========================================================================
+
+/**
+ * @brief Computes the fingerprint of the current opponent.
+ *
+ * Uses the opening shots (first OPENING_LEN):
+ * - f[0] searching shots (not next to an earlier one) on the less used
+ *        checkerboard colour (parity players have none)
+ * - f[1] opening shots into our densest rows (players reading our checksum)
+ * - f[2] opening shots into the central 6x6 (density players)
+ * - f[3] opening shots next to an earlier opening shot (hunt/target players)
+ * Their checksum (largest row count, empty rows) is not used: its spread
+ * between opponents measured zero, it only added noise to the distance.
+ */
+void fingerprint(GameState* game, uint8_t* f) {
+    memset(f, 0, FP_FEATURES);
+
+    // our third-largest row count: rows with at least this many are "dense"
+    uint8_t top[3] = {0, 0, 0};
+    for (uint8_t row = 0; row < ROWS; row++) {
+        uint8_t cs = game->my_checksum[row];
+        if (cs > top[0])      { top[2] = top[1]; top[1] = top[0]; top[0] = cs; }
+        else if (cs > top[1]) { top[2] = top[1]; top[1] = cs; }
+        else if (cs > top[2]) { top[2] = cs; }
+    }
+
+    uint8_t colour[2] = {0, 0};
+    for (uint8_t k = 0; k < OPENING_LEN; k++) {
+        uint8_t x = game->enemy_opening[k] / 10;
+        uint8_t y = game->enemy_opening[k] % 10;
+        bool adjacent = false;
+
+        if (game->my_checksum[x] >= top[2]) f[1]++;
+        if (x >= 2 && x <= 7 && y >= 2 && y <= 7) f[2]++;
+        for (uint8_t j = 0; j < k; j++) {
+            uint8_t px = game->enemy_opening[j] / 10;
+            uint8_t py = game->enemy_opening[j] % 10;
+            if ((px == x && (py == y + 1 || y == py + 1)) || (py == y && (px == x + 1 || x == px + 1))) {
+                adjacent = true;
+                break;
+            }
+        }
+
+        if (adjacent) f[3]++;
+        else colour[(x + y) % 2]++;
+    }
+    f[0] = colour[0] < colour[1] ? colour[0] : colour[1];
+}
+
+/**
+ * @brief Returns a free profile slot, or clears the least recently used one.
+ */
+int8_t new_profile(void) {
+    int8_t slot = 0;
+
+    for (int8_t p = 0; p < MAX_PROFILES; p++) {
+        if (!profiles[p].used) {
+            slot = p;
+            break;
+        }
+        if (profiles[p].last_used < profiles[slot].last_used) slot = p;
+    }
+
+    memset(&profiles[slot], 0, sizeof(OpponentProfile));
+    profiles[slot].used = true;
+    return slot;
+}
+
+/**
+ * @brief Matches the opponent against the stored profiles (after OPENING_LEN shots).
+ *
+ * The distance to a profile is the mean squared z-score of the fingerprint
+ * against the profile's feature means, with the measured within-opponent
+ * variance (fp_within_var). The closest profile becomes active if it is
+ * within FP_MATCH_MAX, otherwise a new profile is created. Our next layout is
+ * chosen against that profile's shot-order model.
+ */
+void classify_opponent(GameState* game) {
+#if USE_FINGERPRINT
+    uint8_t f[FP_FEATURES];
+    fingerprint(game, f);
+
+    int8_t best = -1;
+    float best_dist = FP_MATCH_MAX;
+
+    for (int8_t p = 0; p < MAX_PROFILES; p++) {
+        if (!profiles[p].used || profiles[p].games == 0) continue;
+
+        float g = profiles[p].games;
+        float dist = 0;
+        for (uint8_t k = 0; k < FP_FEATURES; k++) {
+            float mean = profiles[p].feature_sum[k] / g;
+            dist += (f[k] - mean) * (f[k] - mean) / fp_within_var[k];
+        }
+        dist /= FP_FEATURES;
+        if (p == active_profile) dist -= FP_STICKY;
+
+        if (dist < best_dist) {
+            best_dist = dist;
+            best = p;
+        }
+    }
+
+    if (best < 0) best = new_profile();
+
+    OpponentProfile* prof = &profiles[best];
+    if (prof->games == FP_MAX_GAMES) {
+        // keep the means, make room for new games
+        prof->games /= 2;
+        for (uint8_t k = 0; k < FP_FEATURES; k++) {
+            prof->feature_sum[k] /= 2;
+        }
+    }
+    prof->games++;
+    for (uint8_t k = 0; k < FP_FEATURES; k++) {
+        prof->feature_sum[k] += f[k];
+    }
+    prof->last_used = ++profile_clock;
+
+    active_profile = best;
+#endif
+}
+
+/**
+ * @brief Updates the active profile's shot-order model at game end.
+ */
+void learn_opponent(GameState* game) {
+#if USE_FINGERPRINT
+    if (active_profile < 0 || game->enemy_shot_count < OPENING_LEN) return;
+
+    OpponentProfile* prof = &profiles[active_profile];
+    uint8_t n_shots = game->enemy_shot_count < SHOT_ORDER_LEN ? game->enemy_shot_count : SHOT_ORDER_LEN;
+    bool saturated = false;
+
+    for (uint8_t k = 0; k < n_shots; k++) {
+        if (++prof->shot_order[game->enemy_opening[k]] == 255) saturated = true;
+    }
+#if USE_FP_PRIOR
+    // their field was revealed by HD_SF (all zero if the game ended without it)
+    for (uint8_t i = 0; i < FIELD_SIZE; i++) {
+        if (game->enemy_field[i] != '0' && ++prof->ship_prior[i] == 255) saturated = true;
+    }
+#endif
+
+    // age the models instead of overflowing
+    if (saturated) {
+        for (uint8_t i = 0; i < FIELD_SIZE; i++) {
+            prof->shot_order[i] /= 2;
+#if USE_FP_PRIOR
+            prof->ship_prior[i] /= 2;
+#endif
+        }
+    }
+#endif
+}
+
+/**
+ * @brief Placement prior of a cell for the targeter: how often the current
+ * opponent had a ship there (0 without USE_FP_PRIOR or a known opponent).
+ */
+uint8_t cell_prior(uint8_t i) {
+#if USE_FINGERPRINT && USE_FP_PRIOR
+    if (active_profile >= 0) return profiles[active_profile].ship_prior[i];
+#endif
+    (void)i;
+    return 0;
+}
+
+// =========================================================================
+// SECTION: Targeting Heatmap (debug)
+// =========================================================================
+
+/**
+ * @brief Takes a heatmap snapshot of the current game.
+ *
+ * The score of a cell is the number of placements of the ships still afloat
+ * that cover it, not touching water and not exceeding the row checksums.
+ * Placements through hits count HEATMAP_HIT_WEIGHT times more per hit
+ * (target mode). Shot cells score 0.
+ */
+void heatmap_snapshot(GameState* game) {
+    uint32_t score[FIELD_SIZE];
+    uint8_t budget[ROWS];
+    memset(score, 0, sizeof(score));
+
+    // row budget: ship parts not yet hit
+    for (uint8_t row = 0; row < ROWS; row++) {
+        uint8_t hits = 0;
+        for (uint8_t col = 0; col < COLS; col++) {
+            if (game->my_shots[IDX(row, col)] == 'H') hits++;
+        }
+        budget[row] = game->enemy_checksum[row] > hits ? game->enemy_checksum[row] - hits : 0;
+    }
+
+    for (uint8_t len = 2; len <= MAX_SHIP_LEN; len++) {
+        if (game->ships_left[len] == 0) continue;
+
+        for (uint8_t x = 0; x < ROWS; x++) {
+            for (uint8_t y = 0; y < COLS; y++) {
+                for (uint8_t horizontal = 0; horizontal < 2; horizontal++) {
+                    if (horizontal ? y + len > COLS : x + len > ROWS) continue;
+
+                    // check the placement: no water, unhit cells within the row budgets
+                    uint8_t need[ROWS];
+                    uint32_t weight = game->ships_left[len];
+                    bool legal = true;
+                    memset(need, 0, sizeof(need));
+                    for (uint8_t k = 0; k < len && legal; k++) {
+                        uint8_t r = horizontal ? x : x + k;
+                        uint8_t i = horizontal ? IDX(x, y + k) : IDX(x + k, y);
+                        if (cell_is_water(game, i)) legal = false;
+                        else if (game->my_shots[i] == 'H') weight *= HEATMAP_HIT_WEIGHT;
+                        else if (++need[r] > budget[r]) legal = false;
+                    }
+                    if (!legal) continue;
+
+                    for (uint8_t k = 0; k < len; k++) {
+                        score[horizontal ? IDX(x, y + k) : IDX(x + k, y)] += weight;
+                    }
+                }
+            }
+        }
+    }
+
+    heatmap.max_score = 0;
+    for (uint8_t i = 0; i < FIELD_SIZE; i++) {
+        if (game->my_shots[i] != '0') score[i] = 0;
+        if (score[i] > heatmap.max_score) heatmap.max_score = score[i];
+    }
+
+    for (uint8_t i = 0; i < FIELD_SIZE; i++) {
+        // scale to 0..9, any possible cell is at least 1
+        heatmap.score[i] = '0' + (heatmap.max_score ? (score[i] * 9 + heatmap.max_score - 1) / heatmap.max_score : 0);
+
+        if (game->my_shots[i] != '0')        heatmap.state[i] = game->my_shots[i];
+        else if (game->deduced[i] != '0')    heatmap.state[i] = game->deduced[i];
+        else                                 heatmap.state[i] = '.';
+    }
+    memcpy(heatmap.ships_left, game->ships_left, sizeof(heatmap.ships_left));
+}
+
+/**
+ * @brief Sends one line of the heatmap snapshot (0..ROWS-1: rows, ROWS: ships left).
+ */
+void heatmap_print_line(uint8_t line) {
+    if (line < ROWS) {
+        LOG("DH_#HM_%d_%.10s_%.10s\r\n", line, &heatmap.score[IDX(line, 0)], &heatmap.state[IDX(line, 0)]);
+    } else {
+        LOG("DH_#HM_L_%d%d%d%d_%lu\r\n", heatmap.ships_left[2], heatmap.ships_left[3],
+            heatmap.ships_left[4], heatmap.ships_left[5], (unsigned long)heatmap.max_score);
+    }
+}
+
+/**
+ * @brief Deferred debug channel, called once per main loop iteration.
+ *
+ * Takes a pending heatmap snapshot and sends its lines while the host is
+ * quiet; the check is repeated before every line, so a reply is delayed by
+ * at most one short line (or one snapshot). A snapshot still being sent is
+ * finished before the next one is taken. DH_# lines are comments for the host.
+ */
+void debug_deferred(MessageBuffer* msg, GameState* game) {
+    if (heatmap_pending && heatmap_line > ROWS && host_quiet(msg)) {
+        heatmap_snapshot(game);
+        heatmap_line = 0;
+        heatmap_pending = false;
+    }
+    while (heatmap_line <= ROWS) {
+        if (!host_quiet(msg)) return;
+        heatmap_print_line(heatmap_line++);
+    }
+}
@@ -0,0 +1,587 @@
+#!/usr/bin/env python3
+# vim: set ts=4 sw=4 et:
+
+#
+#   MECH-23-EMB-Battleship - round-robin rating tournament between engine variants
+#
+#   players are either firmware variants (src/main.c built natively with -DNATIVE and extra
+#   compiler flags, talking the serial protocol over a pty) or simulator players (schiff.py
+#   fire solutions with schiff.py's field generator). every pair plays the same number of games,
+#   the result is an Elo-style rating with bootstrap confidence intervals written to a report
+#
+
+import argparse
+import logging
+import math
+import multiprocessing
+import os
+import random
+import re
+import shlex
+import subprocess
+import tempfile
+import time
+import tty
+
+import serial
+
+import schiff
+
+REPO_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..')
+
+# total number of ship parts, the game is won with that many hits
+MAX_HITS = sum(map(lambda x: x[0]*x[1], schiff.nr_ships.items()))
+
+# a device that needs more shots than this is considered broken and forfeits the game
+MAX_SHOTS = 2 * schiff.FIELD_SZ * schiff.FIELD_SZ
+
+def build_variant(name, flags, out_dir, cc='cc'):
+    """compile src/main.c for the host, returns the path of the binary"""
+    binary = os.path.join(out_dir, name)
+    cmd = [cc, '-std=gnu11', '-O2', '-DNATIVE', '-I', os.path.join(REPO_DIR, 'include')] + shlex.split(flags) + \
+          [os.path.join(REPO_DIR, 'src', 'main.c'), '-o', binary]
+    logging.info("building {}: {}".format(name, ' '.join(cmd)))
+    res = subprocess.run(cmd, stderr=subprocess.PIPE, text=True)
+    if res.returncode != 0:
+        logging.error("building {} failed:\n{}".format(name, res.stderr))
+        raise RuntimeError("building {} failed ({})".format(name, ' '.join(cmd)))
+    if res.stderr:
+        logging.info("compiler output for {}:\n{}".format(name, res.stderr))
+    return binary
+
+def field_from_rows(rows):
+    """creates a schiff.Field from SF record data (list of 10 strings of digits)"""
+    f = schiff.Field.__new__(schiff.Field)
+    f.sz = schiff.FIELD_SZ
+    f.f = {f.xy_to_idx(x, y): int(rows[x][y]) for x in range(0, f.sz) for y in range(0, f.sz)}
+    f.sf_records = ["SF{}D{}".format(x, rows[x]) for x in range(0, f.sz)]
+    return f
+
+def fleet_ok(field):
+    """cheap sanity check of a field: correct number of cells for every ship length"""
+    cells = list(field.f.values())
+    return all(cells.count(k) == k*n for k,n in schiff.nr_ships.items())
+
+def sim_attack(fs, field, shots=0):
+    """lets fire solution fs shoot at field until it is sunk, returns the number of shots"""
+    while field.ships_left() > 0:
+        xy = fs.get_coord()
+        fs.update(xy, field.shot_at(*xy))
+        shots += 1
+    return shots
+
+class SimPlayer:
+    """a simulator player: schiff.py fire solution + schiff.py field generator"""
+    device = False
+
+    def __init__(self, name, fire_solution):
+        self.name = name
+        self.fs_cls = schiff.fire_solutions[fire_solution]
+
+    def start(self, seed):
+        pass
+
+    def stop(self):
+        pass
+
+    def place(self):
+        return schiff.Field()
+
+    def fire_solution(self, their_cs):
+        return self.fs_cls(their_cs)
+
+class GameDropped(Exception):
+    """the device ended the game early (DH_#END, built with -DCHEAT_END_GAME=1)"""
+
+class DevicePlayer:
+    """a firmware variant running natively behind a pty
+
+    the device generates its field when the game starts and reveals it only after it won,
+    so place() hands out the field of the previous game (bootstrapped with one extra game).
+    """
+    device = True
+
+    def __init__(self, name, binary):
+        self.name = name
+        self.binary = binary
+        self.last_rows = None
+        self.comments = []
+
+    def start(self, seed):
+        master, self.slave = os.openpty()
+        tty.setraw(self.slave)
+        env = dict(os.environ, BATTLESHIP_SEED=str(seed))
+        self.proc = subprocess.Popen([self.binary], stdin=master, stdout=master, env=env)
+        os.close(master)
+        self.port = os.ttyname(self.slave)
+        self.ser = serial.Serial(self.port, 115200, timeout=2)
+
+    def stop(self):
+        self.ser.close()
+        os.close(self.slave)
+        self.proc.terminate()
+        self.proc.wait()
+
+    def send_line(self, text):
+        self.ser.write("{}\r\n".format(text).encode('ascii'))
+
+    def receive(self):
+        while True:
+            l = self.ser.readline()
+            if not l.endswith(b"\n"):
+                raise TimeoutError("{}: timeout while waiting for data from device".format(self.name))
+            l = l.decode('ascii').strip()
+            if l.startswith("DH_#"):
+                self.comments.append(l)
+                if l.startswith("DH_#END"):
+                    raise GameDropped("{}: {}".format(self.name, l))
+                continue
+            return l
+
+    def place(self):
+        if self.last_rows is None:
+            self.game(schiff.Field(), schiff.StupidFireSolution)
+        return field_from_rows(self.last_rows)
+
+    def game(self, field, host_fs, lie=0):
+        """plays one game against field, the host shooting with host_fs(their_cs)
+
+        the host never sinks the device: with one ship part left it repeats an old hit, so the
+        device always plays until it has won. returns the number of shots the device needed
+        (None if it forfeits). the revealed device field is kept for place(), the host's
+        fire solution (with the live shots recorded) in self.last_fs
+
+        with lie > 0 the host reports each hit of the device as a miss with that probability;
+        such a game is abandoned (None) once the device flags it or cannot win any more.
+        self.last_lies holds (reply numbers that were lies, reply number the device flagged or None)
+        a device that drops the game itself (DH_#END instead of a reply) forfeits it (None)
+        """
+        self.send_line("HD_START")
+        if not self.receive().startswith("DH_START_"):
+            raise RuntimeError("{}: expected DH_START_".format(self.name))
+        self.send_line("HD_CS_{}".format(field.get_cs_record()))
+        m = re.match(r"^DH_CS_(\d{10})$", self.receive())
+        if m is None:
+            raise RuntimeError("{}: expected DH_CS_".format(self.name))
+        fs = host_fs(m[1])
+
+        shots = 0
+        lies = []
+        flagged = None
+        n_comments = len(self.comments)
+        self.last_lies = (lies, flagged)
+        while True:
+            holding_back = len(fs.hit_list) >= MAX_HITS - 1 or len(fs.cand) == 0
+            if holding_back:
+                xy = fs.hit_list[0] if len(fs.hit_list) > 0 else (0, 0)
+            else:
+                xy = fs.get_coord()
+            self.send_line("HD_BOOM_{}_{}".format(*xy))
+            try:
+                reply = self.receive()
+            except GameDropped:
+                # flagged after our last reply (the DH_#CHEAT line came right before)
+                if any(c.startswith("DH_#CHEAT") for c in self.comments[n_comments:]):
+                    self.last_lies = (lies, shots)
+                return None
+            m = re.match(r"^DH_BOOM_([HM])$", reply)
+            if m is None:
+                raise RuntimeError("{}: expected DH_BOOM_H/M".format(self.name))
+            if not holding_back:
+                fs.update(xy, m[1] == 'H')
+
+            m = re.match(r"^DH_BOOM_(\d)_(\d)$", self.receive())
+            if m is None:
+                raise RuntimeError("{}: expected DH_BOOM_x_y".format(self.name))
+            shots += 1
+            if flagged is None and any(c.startswith("DH_#CHEAT") for c in self.comments[n_comments:]):
+                flagged = shots - 1
+                self.last_lies = (lies, flagged)
+            they_hit = field.shot_at(int(m[1]), int(m[2]))
+            if field.ships_left() == 0:
+                break
+            if lie > 0 and (flagged is not None or shots >= MAX_SHOTS):
+                return None
+            if shots >= MAX_SHOTS:
+                raise RuntimeError("{}: no win after {} shots".format(self.name, shots))
+            if they_hit and lie > 0 and random.random() < lie:
+                lies.append(shots)
+                they_hit = False
+            self.send_line("HD_BOOM_H" if they_hit else "HD_BOOM_M")
+
+        for sfl in field.get_sf_records():
+            self.send_line("HD_{}".format(sfl))
+        rows = [None] * schiff.FIELD_SZ
+        for _ in range(0, schiff.FIELD_SZ):
+            m = re.match(r"^DH_SF(\d)D(\d{10})$", self.receive())
+            if m is None:
+                raise RuntimeError("{}: expected DH_SF records".format(self.name))
+            rows[int(m[1])] = m[2]
+        self.last_rows = rows
+        self.last_fs = fs
+        return shots if fleet_ok(self.place()) else None
+
+def play_match(a, b):
+    """plays one match, returns the shots a and b needed to sink each other (None: forfeit)
+
+    both sides shoot independently of each other's result, so each side's shots-to-win is
+    measured on its own and the winner decided afterwards
+    """
+    if a.device and b.device:
+        # the host shots a device sees come from the reference player here
+        sa = a.game(b.place(), schiff.StupidFireSolution)
+        sb = b.game(a.place(), schiff.StupidFireSolution)
+        return sa, sb
+    if b.device:
+        sb, sa = play_match(b, a)
+        return sa, sb
+    if a.device:
+        # b's fire solution plays live against the device, then finishes offline on the revealed field
+        sa = a.game(b.place(), b.fire_solution)
+        fs = a.last_fs
+        fa = a.place()
+        if sa is None:
+            return None, 0
+        for xy in fs.hit_list + fs.miss_list:
+            fa.shot_at(*xy)
+        return sa, sim_attack(fs, fa, len(fs.hit_list) + len(fs.miss_list))
+    fa = a.place()
+    fb = b.place()
+    return sim_attack(a.fire_solution(fb.get_cs_record()), fb), sim_attack(b.fire_solution(fa.get_cs_record()), fa)
+
+def winner(sa, sb, a_first):
+    """1 if a won, 0 if b won; a forfeit loses, with equal shots the first shooter wins"""
+    if sa is None or sb is None:
+        return 0 if sa is None else 1
+    if sa == sb:
+        return 1 if a_first else 0
+    return 1 if sa < sb else 0
+
+def run_pairing(task):
+    """worker: plays games between two players
+
+    returns a list of (a, b, a_won, shots a, shots b) and an (empty) list of fingerprint records
+    """
+    specs, i, j, games, seed = task
+    random.seed(seed)
+    players = [make_player(*specs[i][:3]), make_player(*specs[j][:3])]
+    for k,p in enumerate(players):
+        p.start(seed + k)
+    results = []
+    try:
+        for g in range(0, games):
+            sa, sb = play_match(*players)
+            results.append((i, j, winner(sa, sb, g % 2 == 0), sa, sb))
+    except (TimeoutError, RuntimeError) as e:
+        logging.error("pairing {} - {} aborted: {}".format(specs[i][0], specs[j][0], e))
+    finally:
+        for p in players:
+            p.stop()
+    return results, []
+
+def run_mixed(task):
+    """worker: one firmware player against changing simulator opponents (blocks of games)
+
+    the device keeps running, so it has to recognise the opponents itself. after every game
+    the active opponent profile is queried (DD_EVALUATE_FP). returns the game results and
+    a list of fingerprint records (device, opponent, profile slot)
+    """
+    specs, i, opponents, games, block, seed = task
+    random.seed(seed)
+    device = make_player(*specs[i][:3])
+    device.start(seed)
+    sims = {j: make_player(*specs[j][:3]) for j in opponents}
+    played = dict.fromkeys(opponents, 0)
+    results = []
+    fingerprints = []
+    try:
+        while any(n < games for n in played.values()):
+            j = random.choice([j for j,n in played.items() if n < games])
+            for _ in range(0, min(block, games - played[j])):
+                sa, sb = play_match(device, sims[j])
+                results.append((i, j, winner(sa, sb, played[j] % 2 == 0), sa, sb))
+                played[j] += 1
+                device.send_line("DD_EVALUATE_FP")
+                m = re.match(r"^Opponent profile (-?\d+)", device.receive())
+                if m is not None:
+                    fingerprints.append((i, j, int(m[1])))
+    except (TimeoutError, RuntimeError) as e:
+        logging.error("mixed games of {} aborted: {}".format(specs[i][0], e))
+    finally:
+        device.stop()
+    return results, fingerprints
+
+def run_liar(task):
+    """worker: one firmware player against simulator hosts that lie about its hits
+
+    returns no game results, but a list of lie records (device, opponent, reply numbers that
+    were lies, reply number the device flagged or None, shots the device fired) followed by
+    the device's DD_EVALUATE_CONSIST statistics as (device, None, line)
+    """
+    specs, i, opponents, games, lie, seed = task
+    random.seed(seed)
+    device = make_player(*specs[i][:3])
+    device.start(seed)
+    sims = {j: make_player(*specs[j][:3]) for j in opponents}
+    records = []
+    try:
+        for g in range(0, games):
+            j = opponents[g % len(opponents)]
+            shots = device.game(sims[j].place(), sims[j].fire_solution, lie)
+            lies, flagged = device.last_lies
+            records.append((i, j, lies, flagged, shots))
+        device.send_line("DD_EVALUATE_CONSIST")
+        records.append((i, None, device.receive()))
+    except (TimeoutError, RuntimeError) as e:
+        logging.error("liar games of {} aborted: {}".format(specs[i][0], e))
+    finally:
+        device.stop()
+    return [], records
+
+def write_liar_report(path, specs, records, lie, elapsed):
+    with open(path, 'w') as f:
+        f.write("# Lie detection report\n\n")
+        f.write("{} games in {:.1f} s, the hosts report each device hit as a miss with probability {}\n\n".format(
+            sum(1 for r in records if r[1] is not None), elapsed, lie))
+        f.write("| device | games | with lies | flagged | missed | false alarms | latency (replies) mean / median / max |\n")
+        f.write("| ------ | ----- | --------- | ------- | ------ | ------------ | -------------------------------------- |\n")
+        for i in sorted(set(r[0] for r in records)):
+            games = [r for r in records if r[0] == i and r[1] is not None]
+            lying = [r for r in games if len(r[2]) > 0]
+            caught = [r for r in lying if r[3] is not None]
+            latency = sorted(r[3] - r[2][0] for r in caught)
+            false_alarms = sum(1 for r in games if r[3] is not None and (len(r[2]) == 0 or r[3] < r[2][0]))
+            lat = "{:.1f} / {} / {}".format(sum(latency) / len(latency), latency[len(latency) // 2], latency[-1]) \
+                  if len(latency) > 0 else "-"
+            f.write("| {} | {} | {} | {} | {} | {} | {} |\n".format(specs[i][0], len(games), len(lying), len(caught),
+                                                                 len(lying) - len(caught), false_alarms, lat))
+        f.write("\nLatency counts the host replies from the first lie up to the one after which the device flagged it.\n")
+        f.write("\n## Consistency check statistics (DD_EVALUATE_CONSIST)\n\n")
+        for r in records:
+            if r[1] is None:
+                f.write("- `{}`: {}\n".format(specs[r[0]][0], r[2]))
+        f.write("\n## Players\n\n")
+        for name,kind,_,desc in specs:
+            f.write("- `{}`: {} `{}`\n".format(name, kind, desc))
+
+def make_player(name, kind, arg):
+    if kind == 'fw':
+        return DevicePlayer(name, arg)
+    return SimPlayer(name, arg)
+
+def ratings(n, results, iterations=100):
+    """Bradley-Terry maximum likelihood on the Elo scale (400 points = 10:1 odds), mean 1500
+
+    every pair gets half a virtual win each way, so undefeated players stay finite
+    """
+    wins = [[0.5 if a != b else 0 for b in range(0, n)] for a in range(0, n)]
+    for a,b,a_won,_,_ in results:
+        if a_won:
+            wins[a][b] += 1
+        else:
+            wins[b][a] += 1
+    p = [1.0] * n
+    for _ in range(0, iterations):
+        for a in range(0, n):
+            w = sum(wins[a])
+            d = sum((wins[a][b] + wins[b][a]) / (p[a] + p[b]) for b in range(0, n) if b != a)
+            p[a] = w / d
+        mean = sum(math.log10(x) for x in p) / n
+        p = [x / 10**mean for x in p]
+    return [1500 + 400 * math.log10(x) for x in p]
+
+def confidence(n, results, samples, level=0.95):
+    """bootstrap confidence intervals for the ratings, resampling whole games"""
+    runs = [ratings(n, random.choices(results, k=len(results))) for _ in range(0, samples)]
+    lo = int((1 - level) / 2 * samples)
+    hi = min(samples - 1, int((1 + level) / 2 * samples))
+    return [(sorted(r[k] for r in runs)[lo], sorted(r[k] for r in runs)[hi]) for k in range(0, n)]
+
+def fingerprint_accuracy(records):
+    """share of games whose profile slot is the one mostly used for that opponent, and vice versa
+
+    (the purity of the opponent -> profile assignment, 1.0 means every opponent got its own slot;
+    None if the device keeps no profiles)
+    """
+    if len(records) == 0 or all(slot < 0 for _,_,slot in records):
+        return None
+    count = {}
+    for _,j,slot in records:
+        count[(j, slot)] = count.get((j, slot), 0) + 1
+    correct = 0
+    for (j, slot),n in count.items():
+        # the slot is "correct" for j if j is its main user and it is j's main slot
+        main_user = max((c, jj) for (jj, ss),c in count.items() if ss == slot)[1]
+        main_slot = max((c, ss) for (jj, ss),c in count.items() if jj == j)[1]
+        if main_user == j and main_slot == slot:
+            correct += n
+    return correct / len(records)
+
+def write_report(path, specs, results, elapsed, fingerprints=[]):
+    n = len(specs)
+    r = ratings(n, results)
+    ci = confidence(n, results, 200)
+    with open(path, 'w') as f:
+        f.write("# Arena report\n\n")
+        f.write("{} games in {:.1f} s ({:.1f} games/s)\n\n".format(len(results), elapsed, len(results) / elapsed))
+        f.write("| rank | player | kind | rating | 95% CI | won | lost | mean shots-to-win | forfeits |\n")
+        f.write("| ---- | ------ | ---- | ------ | ------ | --- | ---- | ----------------- | -------- |\n")
+        for rank,k in enumerate(sorted(range(0, n), key=lambda k: -r[k])):
+            won = sum(1 for a,b,w,_,_ in results if (a == k and w) or (b == k and not w))
+            lost = sum(1 for a,b,_,_,_ in results if k in (a, b)) - won
+            shots = [sa for a,_,_,sa,_ in results if a == k] + [sb for _,b,_,_,sb in results if b == k]
+            valid = [x for x in shots if x is not None]
+            mean = "{:.1f}".format(sum(valid) / len(valid)) if len(valid) > 0 else "-"
+            f.write("| {} | {} | {} | {:.0f} | {:.0f} .. {:.0f} | {} | {} | {} | {} |\n".format(
+                rank + 1, specs[k][0], specs[k][1], r[k], ci[k][0], ci[k][1], won, lost, mean, len(shots) - len(valid)))
+        f.write("\n## Score matrix (row player wins against column player)\n\n")
+        f.write("| | " + " | ".join(s[0] for s in specs) + " |\n")
+        f.write("|---" * (n + 1) + "|\n")
+        for a in range(0, n):
+            cells = []
+            for b in range(0, n):
+                if a == b:
+                    cells.append("-")
+                    continue
+                played = [x for x in results if (x[0], x[1]) in [(a, b), (b, a)]]
+                won = sum(1 for x in played if (x[0] == a) == bool(x[2]))
+                cells.append("{}/{}".format(won, len(played)))
+            f.write("| {} | ".format(specs[a][0]) + " | ".join(cells) + " |\n")
+        f.write("\n## Mean shots-to-win (row player shooting at column player's fields)\n\n")
+        f.write("| | " + " | ".join(s[0] for s in specs) + " |\n")
+        f.write("|---" * (n + 1) + "|\n")
+        for a in range(0, n):
+            cells = []
+            for b in range(0, n):
+                shots = [x[3] for x in results if (x[0], x[1]) == (a, b) and x[3] is not None] + \
+                        [x[4] for x in results if (x[0], x[1]) == (b, a) and x[4] is not None]
+                cells.append("{:.1f}".format(sum(shots) / len(shots)) if len(shots) > 0 else "-")
+            f.write("| {} | ".format(specs[a][0]) + " | ".join(cells) + " |\n")
+        devices = sorted(set(i for i,_,_ in fingerprints))
+        if len(devices) > 0:
+            f.write("\n## Opponent fingerprinting (mixed opponents)\n\n")
+            f.write("| device | games | accuracy | profile slots used per opponent |\n")
+            f.write("| ------ | ----- | -------- | ------------------------------- |\n")
+            for i in devices:
+                records = [x for x in fingerprints if x[0] == i]
+                slots = ", ".join("{}: {}".format(specs[j][0], sorted(set(s for ii,jj,s in records if jj == j)))
+                                  for j in sorted(set(j for _,j,_ in records)))
+                accuracy = fingerprint_accuracy(records)
+                f.write("| {} | {} | {} | {} |\n".format(specs[i][0], len(records),
+                                                        "-" if accuracy is None else "{:.0%}".format(accuracy), slots))
+        f.write("\n## Players\n\n")
+        for name,kind,_,desc in specs:
+            f.write("- `{}`: {} `{}`\n".format(name, kind, desc))
+
+def parse_player(text):
+    """fw:NAME[=FLAGS] or py:FIRE_SOLUTION, returns (name, kind, flags or fire solution)"""
+    kind, _, rest = text.partition(':')
+    if kind == 'fw':
+        name, _, flags = rest.partition('=')
+        return name, kind, flags
+    if kind == 'py' and rest in schiff.fire_solutions:
+        return rest, kind, rest
+    raise argparse.ArgumentTypeError("player must be fw:NAME[=FLAGS] or py:{{{}}}".format(','.join(schiff.fire_solutions)))
+
+def serve(binary):
+    """runs a single firmware variant behind a pty until interrupted, e.g. for schiff.py"""
+    p = DevicePlayer('serve', binary)
+    p.start(int(time.time()))
+    p.ser.close()
+    print("device listening on {}".format(p.port), flush=True)
+    try:
+        p.proc.wait()
+    except KeyboardInterrupt:
+        pass
+    finally:
+        os.close(p.slave)
+        p.proc.terminate()
+
+def main(args):
+    # the firmware binaries only live as long as the run
+    with tempfile.TemporaryDirectory(prefix='arena-') as build_dir:
+        play(args, build_dir)
+
+def play(args, build_dir):
+    specs = []
+    for name,kind,arg in args.player:
+        if kind == 'fw':
+            specs.append((name, kind, build_variant(name, arg, build_dir, args.cc), "-DNATIVE " + arg))
+        else:
+            specs.append((name, kind, arg, arg))
+    if args.serve:
+        serve(specs[0][2])
+        return
+    if not args.no_reference and not any(k == 'py' and a == 'stupid' for _,k,a,_ in specs):
+        specs.append(('reference', 'py', 'stupid', 'stupid'))
+
+    tasks = []
+    seed = args.seed
+    if args.liar is not None:
+        # every firmware player meets the simulator players (in turns) as lying hosts, one task per device
+        opponents = [j for j in range(0, len(specs)) if specs[j][1] == 'py']
+        for i in range(0, len(specs)):
+            if specs[i][1] == 'fw':
+                tasks.append((specs, i, opponents, args.games, args.liar, seed))
+                seed += 100
+        worker = run_liar
+    elif args.mixed:
+        # every firmware player meets all simulator players in random blocks, one task per device
+        opponents = [j for j in range(0, len(specs)) if specs[j][1] == 'py']
+        for i in range(0, len(specs)):
+            if specs[i][1] == 'fw':
+                tasks.append((specs, i, opponents, args.games, args.mixed, seed))
+                seed += 100
+        worker = run_mixed
+    else:
+        # every pairing is split into chunks, so all cores stay busy
+        chunk = max(1, min(args.chunk, args.games))
+        for i in range(0, len(specs)):
+            for j in range(i + 1, len(specs)):
+                for start in range(0, args.games, chunk):
+                    tasks.append((specs, i, j, min(chunk, args.games - start), seed))
+                    seed += 100
+        worker = run_pairing
+
+    t0 = time.time()
+    results = []
+    records = []    # fingerprint (--mixed) or lie (--liar) records
+    with multiprocessing.Pool(args.jobs) as pool:
+        for r,rec in pool.imap_unordered(worker, tasks):
+            results += r
+            records += rec
+            print(".", end="", flush=True)
+    print("")
+    elapsed = time.time() - t0
+
+    if args.liar is not None:
+        write_liar_report(args.report, specs, records, args.liar, elapsed)
+    else:
+        write_report(args.report, specs, results, elapsed, records)
+    with open(args.report) as f:
+        print(f.read())
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="round-robin rating tournament between firmware variants and simulator players",
+                                     epilog="example: arena.py -p fw:base -p 'fw:other=-DSOME_SWITCH=0' -p py:density")
+    parser.add_argument('-p', '--player', action='append', type=parse_player, required=True,
+                        help="fw:NAME[=CFLAGS] builds src/main.c natively with CFLAGS, py:FIRE_SOLUTION is a schiff.py simulator player")
+    parser.add_argument('-g', '--games', type=int, default=100, help="games per pairing (default: 100)")
+    parser.add_argument('-j', '--jobs', type=int, default=os.cpu_count(), help="worker processes (default: all cores)")
+    parser.add_argument('--chunk', type=int, default=20, help="games per worker task (default: 20)")
+    parser.add_argument('--seed', type=int, default=1)
+    parser.add_argument('--cc', default='cc', help="host C compiler (default: cc)")
+    parser.add_argument('-r', '--report', default='arena_report.md', help="report file (default: arena_report.md)")
+    parser.add_argument('--no-reference', action='store_true', help="do not add the reference host (py:stupid) to the players")
+    parser.add_argument('--mixed', type=int, metavar='BLOCK',
+                        help="instead of the round-robin let each fw player meet the py players in random blocks of BLOCK games "
+                             "on one running device (opponent fingerprinting)")
+    parser.add_argument('--liar', type=float, metavar='P',
+                        help="instead of the round-robin let each fw player play GAMES games against the py players as hosts "
+                             "that report a device hit as a miss with probability P, and report how fast the lies are detected")
+    parser.add_argument('--serve', action='store_true', help="only build the first fw player and serve it on a pty (for schiff.py)")
+    parser.add_argument('-v', '--verbose', action='store_true')
+    args = parser.parse_args()
+
+    logging.basicConfig(level=logging.INFO if args.verbose else logging.WARN)
+    main(args)
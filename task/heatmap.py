@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+# vim: set ts=4 sw=4 et:
+
+#
+#   MECH-23-EMB-Battleship - renders the targeting heatmap of the device
+#
+#   the device sends its heatmap as DH_# comment lines (DD_HEATMAP, or after each of its shots
+#   once streaming is on with DD_HEATMAP_ON):
+#       DH_#HM_{row}_{10 scores 0..9}_{10 states}     one line per row
+#       DH_#HM_L_{ships of length 2,3,4,5 left}_{max. score}
+#   states: '.' unknown, 'W' proven water, 'S' forced ship, 'H' hit, 'M' miss
+#
+#   the lines are read from a log (e.g. the output of schiff.py, which prints comment lines)
+#   or straight from the serial device
+#
+
+import argparse
+import re
+import sys
+
+import serial
+
+ROW_RE = re.compile(r"DH_#HM_(\d)_(\d{10})_([.WSHM]{10})")
+END_RE = re.compile(r"DH_#HM_L_(\d)(\d)(\d)(\d)_(\d+)")
+
+# how a cell is drawn: shot and proven cells by state, unknown cells by score
+STATE_CHARS = {'H': 'X', 'M': 'o', 'W': '~', 'S': '#'}
+SHADES = " ,:;-=+*%@"
+
+class Heatmap:
+    """collects the lines of one heatmap snapshot"""
+    def __init__(self):
+        self.rows = {}
+
+    def feed(self, line):
+        """feeds one line, returns True when a snapshot is complete"""
+        m = ROW_RE.search(line)
+        if m:
+            if int(m[1]) == 0:
+                self.rows = {}  # a new snapshot starts (an unfinished one was superseded)
+            self.rows[int(m[1])] = (m[2], m[3])
+            return False
+        m = END_RE.search(line)
+        if m:
+            self.ships_left = {k: int(m[k-1]) for k in range(2, 6)}
+            self.max_score = int(m[5])
+            return len(self.rows) == 10
+        return False
+
+    def render(self, color):
+        out = ["   " + " ".join(str(y) for y in range(0, 10))]
+        for x in range(0, 10):
+            scores, states = self.rows[x]
+            cells = []
+            for s,st in zip(scores, states):
+                c = STATE_CHARS.get(st, SHADES[int(s)])
+                if color and st == '.':
+                    # grey -> red with the score
+                    c = "\x1b[48;5;{}m{}\x1b[0m".format([236, 237, 239, 241, 94, 130, 166, 202, 196, 160][int(s)], c)
+                cells.append(c)
+            out.append("{:2} ".format(x) + " ".join(cells) + "   " + scores)
+        left = ", ".join("{}x{}".format(n, k) for k,n in sorted(self.ships_left.items(), reverse=True) if n > 0)
+        out.append("ships left: {} - max. score {}".format(left if left else "none", self.max_score))
+        return "\n".join(out)
+
+def lines_from_device(args):
+    dev = serial.serial_for_url(args.ser_dev, 115200, timeout=2)
+    if args.stream is not None:
+        dev.write("DD_HEATMAP_{}\r\n".format(args.stream.upper()).encode('ascii'))
+        print(dev.readline().decode('ascii').strip())
+        return
+    dev.write(b"DD_HEATMAP\r\n")
+    while True:
+        l = dev.readline()
+        if l == b"":
+            break
+        yield l.decode('ascii', 'replace')
+
+def main(args):
+    if args.ser_dev is not None:
+        lines = lines_from_device(args)
+    elif args.log is not None:
+        lines = open(args.log)
+    else:
+        lines = sys.stdin
+
+    hm = Heatmap()
+    n = 0
+    for l in lines:
+        if hm.feed(l):
+            n += 1
+            if args.clear:
+                print("\x1b[H\x1b[2J", end="")
+            print("heatmap #{}".format(n))
+            print(hm.render(args.color))
+            print(flush=True)
+            if args.ser_dev is not None:
+                break
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="render the device's targeting heatmap (DD_HEATMAP)")
+    parser.add_argument('-d', '--ser-dev', help="ask the device on this serial port for a heatmap (DD_HEATMAP)")
+    parser.add_argument('--stream', choices=['on', 'off'],
+                        help="with -d: switch streaming after each of the device's shots on/off and exit")
+    parser.add_argument('-l', '--log', help="read the heatmap lines from this log instead of stdin")
+    parser.add_argument('-c', '--color', action='store_true', help="colour unknown cells by score (ANSI)")
+    parser.add_argument('--clear', action='store_true', help="clear the terminal before each heatmap (live view)")
+    main(parser.parse_args())
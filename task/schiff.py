@@ -31,36 +31,57 @@ class SerialIO:
     """ handling communication over the serial port
 
     provides convenience function like receiving and sending lines and implements timeout
+    received bytes are read in bulk (whatever the port has waiting) and split into lines here,
+    a partial line stays in the buffer until its line end arrives
     """
     def __init__(self, args):
         self.ser_dev = args.ser_dev
         self.notimeout = args.notimeout
+        self.coalesce = args.coalesce
         self.dev = serial.serial_for_url(self.ser_dev, 115200, timeout=2)
+        self.rx_buf = b""
 
     def send_line(self, text):
         logging.debug("-->{}".format(text))
         self.dev.write("{}\r\n".format(text).encode('ascii'))
 
+    def send_lines(self, lines):
+        """sends several lines, with --coalesce in a single write"""
+        if not self.coalesce:
+            for l in lines:
+                self.send_line(l)
+            return
+        for l in lines:
+            logging.debug("-->{}".format(l))
+        self.dev.write("".join("{}\r\n".format(l) for l in lines).encode('ascii'))
+
+    def read_line(self):
+        """returns the next line (without line end), None on timeout"""
+        while True:
+            end = self.rx_buf.find(b"\n")
+            if end >= 0:
+                l = self.rx_buf[:end]
+                self.rx_buf = self.rx_buf[end+1:]
+                return l.replace(b"\r", b"").decode('ascii')
+            # blocks for the first byte (up to the timeout), takes everything else that is waiting
+            data = self.dev.read(max(1, self.dev.in_waiting))
+            if data == b"":
+                return None
+            self.rx_buf += data
+
     def receive(self, callback):
-        l = ""
         while True:
-            c = self.dev.read(1)
-            if c == b"":
+            l = self.read_line()
+            if l is None:
                 if self.notimeout:
                     continue
                 else:
                     raise TimeoutError('timeout while waiting for data from device')
-            if c == b"\r":
+            if l.startswith("DH_#"):
+                # this is a comment line, just print it
+                print("COMMENT: {}".format(l))
                 continue
-            if c == b"\n":
-                if l.startswith("DH_#"):
-                    # this is a comment line, just print it
-                    print("COMMENT: {}".format(l))
-                    l = ""
-                    continue
-                else:
-                    break
-            l += c.decode('ascii')
+            break
         logging.debug("<--{}".format(l))
         return callback(l, False)
 
@@ -258,6 +279,224 @@ class StupidFireSolution(FireSolution):
         # pick a random candiate (and remove form candidate list)
         return self.cand.pop(random.randint(0, len(self.cand)-1))
 
+class HuntTargetFireSolution(FireSolution):
+    """the classic hunt/target player
+
+    hunts at random until something is hit, then works through the neighbours of the hit (target mode).
+    ships must not touch, so the diagonal neighbours of a hit are water; they are only fired at once
+    nothing else is left (a field breaking the no-touch rule must not run us out of candidates)
+    """
+    def __init__(self, their_cs, sz=FIELD_SZ):
+        super().__init__(their_cs, sz)
+        self.targets = []
+        self.water = set()
+
+    def neighbours(self, coord):
+        r,c = coord
+        return [(rr,cc) for rr,cc in [(r-1,c), (r+1,c), (r,c-1), (r,c+1)] if 0 <= rr < self.sz and 0 <= cc < self.sz]
+
+    def hunt_cand(self):
+        """candidates considered while hunting, overload to restrict the search pattern"""
+        cand = [xy for xy in self.cand if xy not in self.water]
+        return cand if len(cand) > 0 else self.cand
+
+    def get_coord(self) -> tuple[int, int]:
+        while len(self.targets) > 0:
+            coord = self.targets.pop()
+            if coord in self.cand and coord not in self.water:
+                self.cand.remove(coord)
+                return coord
+        if len(self.cand) == 0:
+            raise RuntimeError('no more fire coords, the enemy MUST be dead already, liar!')
+        coord = random.choice(self.hunt_cand())
+        self.cand.remove(coord)
+        return coord
+
+    def update(self, coord, was_a_hit):
+        super().update(coord, was_a_hit)
+        if not was_a_hit:
+            return
+        r,c = coord
+        # no-touch rule: diagonal neighbours of a hit can not be part of any ship
+        for rr,cc in [(r-1,c-1), (r-1,c+1), (r+1,c-1), (r+1,c+1)]:
+            self.water.add((rr,cc))
+        # if the hit continues an earlier hit the ship lies on that line, prefer to follow it
+        in_line = [n for n in self.neighbours(coord) if n in self.hit_list]
+        for n in self.neighbours(coord):
+            if n in self.cand and (len(in_line) == 0 or n[0] == in_line[0][0] or n[1] == in_line[0][1]):
+                self.targets.append(n)
+
+class ParityFireSolution(HuntTargetFireSolution):
+    """hunt/target, but hunting only on a checkerboard
+
+    the smallest ship has length 2, so every ship covers at least one cell of either colour
+    """
+    def hunt_cand(self):
+        cand = super().hunt_cand()
+        parity = [(r,c) for r,c in cand if (r+c) % 2 == 0]
+        return parity if len(parity) > 0 else cand
+
+class DensityFireSolution(FireSolution):
+    """probability density player, fires at the cell covered by most legal ship placements
+
+    the knowledge about their field is a snapshot of three bitmasks over the field (bit x*sz+y):
+    hits, water (misses and cells proven empty) and shot cells. a placement is legal when it
+    does not cover water and does not exceed the announced checksum of any row.
+    placements running through hits are weighted up heavily, which gives target mode for free
+    """
+    HIT_WEIGHT = 50
+
+    def __init__(self, their_cs, sz=FIELD_SZ):
+        super().__init__(their_cs, sz)
+        self.row_cs = [int(c) for c in their_cs]
+        self.row_masks = [sum(1 << self.bit(x, y) for y in range(0, sz)) for x in range(0, sz)]
+        self.hit_mask = 0
+        self.water_mask = 0
+        self.shot_mask = 0
+        # placements: (nr. of such ships, mask, bits covered, ((row, cells in row), ...))
+        self.placements = []
+        for k,n in nr_ships.items():
+            for x in range(0, sz):
+                for y in range(0, sz):
+                    if y+k <= sz:
+                        self.add_placement(n, [(x, y+i) for i in range(0, k)])
+                    if x+k <= sz:
+                        self.add_placement(n, [(x+i, y) for i in range(0, k)])
+
+    def add_placement(self, n, cells):
+        bits = tuple(self.bit(*xy) for xy in cells)
+        mask = sum(1 << b for b in bits)
+        rows = tuple((r, mask & self.row_masks[r]) for r in sorted(set(x for x,_ in cells)))
+        self.placements.append((n, mask, bits, rows))
+
+    def bit(self, x, y):
+        return x*self.sz+y
+
+    def diagonals(self, b):
+        """mask of the diagonal neighbours of bit b"""
+        r,c = divmod(b, self.sz)
+        return sum(1 << self.bit(rr, cc) for rr,cc in [(r-1,c-1), (r-1,c+1), (r+1,c-1), (r+1,c+1)]
+                   if 0 <= rr < self.sz and 0 <= cc < self.sz)
+
+    def scores(self, hit_mask, water_mask):
+        """density for a snapshot, returns a list of scores indexed by bit (0 for impossible cells)"""
+        row_left = [self.row_cs[r] - (hit_mask & self.row_masks[r]).bit_count() for r in range(0, self.sz)]
+        # rows whose budget is used up contain nothing but water
+        for r in range(0, self.sz):
+            if row_left[r] <= 0:
+                water_mask |= self.row_masks[r] & ~hit_mask
+
+        score = [0] * (self.sz * self.sz)
+        for n,mask,bits,rows in self.placements:
+            if mask & water_mask:
+                continue
+            covered = (mask & hit_mask).bit_count()
+            if covered == len(bits):
+                continue
+            if any((rm & ~hit_mask).bit_count() > row_left[r] for r,rm in rows):
+                continue
+            w = n * self.HIT_WEIGHT ** covered
+            for b in bits:
+                score[b] += w
+        return score
+
+    def candidates(self, score, shot_mask):
+        """bits we may still fire at, best density first"""
+        cand = [b for b in range(0, self.sz * self.sz) if score[b] > 0 and not (shot_mask >> b) & 1]
+        return sorted(cand, key=lambda b: -score[b])
+
+    def density(self):
+        """returns a dict coord -> score for every coordinate we may still fire at"""
+        score = self.scores(self.hit_mask, self.water_mask)
+        return {xy: score[self.bit(*xy)] for xy in self.cand}
+
+    def pick(self, score):
+        """chooses the bit to fire at given the density of the current snapshot"""
+        best = max(score[self.bit(*xy)] for xy in self.cand)
+        return self.bit(*random.choice([xy for xy in self.cand if score[self.bit(*xy)] == best]))
+
+    def get_coord(self) -> tuple[int, int]:
+        if len(self.cand) == 0:
+            raise RuntimeError('no more fire coords, the enemy MUST be dead already, liar!')
+        coord = divmod(self.pick(self.scores(self.hit_mask, self.water_mask)), self.sz)
+        self.cand.remove(coord)
+        return coord
+
+    def update(self, coord, was_a_hit):
+        super().update(coord, was_a_hit)
+        b = self.bit(*coord)
+        self.shot_mask |= 1 << b
+        if was_a_hit:
+            self.hit_mask |= 1 << b
+            # no-touch rule: diagonal neighbours of a hit are water
+            self.water_mask |= self.diagonals(b)
+        else:
+            self.water_mask |= 1 << b
+
+class LookaheadFireSolution(DensityFireSolution):
+    """density player with a depth-limited expectimax search over the next shots
+
+    greedy density ignores how a result shapes the following shots. when only few candidate cells
+    are left (typically while sinking a ship) we search 2-3 shots ahead and maximise the expected
+    number of hits, the hit probability of a cell taken from the density of that snapshot.
+    snapshots are immutable (hit, water, shot) bitmask tuples, a child only creates new ints, and
+    values are kept in a transposition cache so subtrees reached in different order are shared
+    """
+    MAX_CAND = 12   # search only when at most that many cells are left to choose from
+    DEEP_CAND = 6   # ... and look 3 instead of 2 shots ahead with at most that many
+    BRANCH = 5      # children per node, best by density
+
+    def __init__(self, their_cs, sz=FIELD_SZ):
+        super().__init__(their_cs, sz)
+        self.max_hits = sum(map(lambda x: x[0]*x[1], nr_ships.items()))
+        self.cache = {}
+
+    def hit_prob(self, state, score, b):
+        """estimated probability that bit b is a ship part in this snapshot"""
+        left = self.max_hits - state[0].bit_count()
+        total = sum(score[c] for c in range(0, len(score)) if not (state[2] >> c) & 1)
+        return min(0.99, left * score[b] / total) if total > 0 else 0
+
+    def children(self, state, b):
+        hit_mask, water_mask, shot_mask = state
+        hit = (hit_mask | 1 << b, water_mask | self.diagonals(b), shot_mask | 1 << b)
+        miss = (hit_mask, water_mask | 1 << b, shot_mask | 1 << b)
+        return hit, miss
+
+    def q(self, state, score, b, depth):
+        """expected hits when firing at b now and searching depth-1 shots further"""
+        p = self.hit_prob(state, score, b)
+        hit, miss = self.children(state, b)
+        return p * (1 + self.value(hit, depth-1)) + (1-p) * self.value(miss, depth-1)
+
+    def value(self, state, depth):
+        if depth == 0 or state[0].bit_count() >= self.max_hits:
+            return 0
+        key = (state, depth)
+        if key not in self.cache:
+            score = self.scores(state[0], state[1])
+            cand = self.candidates(score, state[2])[:self.BRANCH]
+            self.cache[key] = max((self.q(state, score, b, depth) for b in cand), default=0)
+        return self.cache[key]
+
+    def pick(self, score):
+        state = (self.hit_mask, self.water_mask, self.shot_mask)
+        cand = self.candidates(score, self.shot_mask)
+        if len(cand) < 2 or len(cand) > self.MAX_CAND:
+            return super().pick(score)
+        depth = 3 if len(cand) <= self.DEEP_CAND else 2
+        # max() keeps the first of equal values, i.e. the one with the higher density
+        return max(cand[:self.BRANCH], key=lambda b: self.q(state, score, b, depth))
+
+# fire solutions selectable on the command line, key ... name used for -f and in the tournament report
+fire_solutions = {
+    'stupid': StupidFireSolution,
+    'hunt': HuntTargetFireSolution,
+    'parity': ParityFireSolution,
+    'density': DensityFireSolution,
+    'lookahead': LookaheadFireSolution,
+}
+
 class StateMachine:
     """ a state machine implementing the game protocol
     """
@@ -529,7 +768,7 @@ class StateMachine:
             else:
                 logging.info("they MISS @{}".format(xy))
 
-            logging.info("Our Gamefield\n: {}".format(self.f))
+            logging.info("Our Gamefield\n: %s", self.f)  # formatted only when logged
         else:
             # now that we've won alredy we send our SF records to the opponent
             send_sf_records = True
@@ -545,8 +784,7 @@ class StateMachine:
 
         if send_sf_records:
             # when we've lost or when we've won we need to send our SF records, do it
-            for sfl in self.f.get_sf_records():
-                self.ser_io.send_line("HD_{}".format(sfl))
+            self.ser_io.send_lines(["HD_{}".format(sfl) for sfl in self.f.get_sf_records()])
         else:
             if they_hit:
                 self.ser_io.send_line("HD_BOOM_H")
@@ -571,34 +809,40 @@ class StateMachine:
 def main(state_machine, args):
     logging.info("Starting protocol on {}".format(state_machine.ser_io.ser_dev))
 
+    # tournament results per opponent (fire solution), value ... [won, lost, aborted]
+    opponents = args.fire_solution if args.fire_solution else ['stupid']
+    results = {name: [0, 0, 0] for name in opponents}
     cnt = 0
-    aborted = 0
-    won = 0
-    lost = 0
-
-    if args.tournament:
-        print("0--------1---------2---------3---------4---------5---------6---------7---------8---------9---------|")
 
     while True:
+        # in tournament mode each opponent plays a block of 100 games, otherwise they take turns
+        if args.tournament:
+            opponent = opponents[cnt // 100]
+            if cnt % 100 == 0:
+                print("{}:".format(opponent))
+                print("0--------1---------2---------3---------4---------5---------6---------7---------8---------9---------|")
+        else:
+            opponent = opponents[cnt % len(opponents)]
+
         tournament_result_char = 'a'
         try:
             state_machine.reset()
             our_field = Field()
-            logging.info("Our Gamefield\n: {}".format(our_field))
+            logging.info("Our Gamefield\n: %s", our_field)  # formatted only when logged
             state_machine.start(our_field)
 
             # now that we know opponents Checksum create our fire-solution, and pass in their_cs, we may use it
-            fire_solution = StupidFireSolution(state_machine.their_cs)
+            fire_solution = fire_solutions[opponent](state_machine.their_cs)
             state_machine.set_fire_solution(fire_solution)
 
             while not state_machine.is_finished():
                 state_machine.play()
 
             if state_machine.we_won:
-                won += 1
+                results[opponent][0] += 1
                 tournament_result_char = 'w'
             else:
-                lost += 1
+                results[opponent][1] += 1
                 tournament_result_char = 'l'
 
         except (TimeoutError, RuntimeError) as e:
@@ -606,22 +850,24 @@ def main(state_machine, args):
                 logging.error("Exception in game-loop, will reset the game state")
                 logging.error(e)
                 traceback.print_exc()
-            aborted += 1
+            results[opponent][2] += 1
 
         if args.single:
             return
 
         cnt += 1
-        if args.tournament and cnt >= 100:
-            print("")
-            print("TOURNAMENT RESULT: played {} (we won/we lost/aborted): {} {} {}".format(cnt, won, lost, aborted))
-            return
-
         if not args.tournament:
             logging.debug("waiting 1 second")
             time.sleep(1)
-        else:
-            print(tournament_result_char, end="", flush=True)
+            continue
+
+        print(tournament_result_char, end="", flush=True)
+        if cnt % 100 == 0:
+            print("")
+        if cnt >= 100 * len(opponents):
+            for name in opponents:
+                print("TOURNAMENT RESULT {}: played {} (we won/we lost/aborted): {} {} {}".format(name, sum(results[name]), *results[name]))
+            return
 
 if __name__ == "__main__":
     parser = argparse.ArgumentParser(epilog="Ein Schiff im Hafen ist sicher, doch dafür werden Schiffe nicht gebaut")
@@ -630,6 +876,9 @@ if __name__ == "__main__":
     parser.add_argument('-s', '--single', action='store_true')
     parser.add_argument('-n', '--notimeout', action='store_true')
     parser.add_argument('-t', '--tournament', action='store_true')
+    parser.add_argument('-c', '--coalesce', action='store_true', help="send the ten HD_SF lines in a single write")
+    parser.add_argument('-f', '--fire-solution', action='append', choices=fire_solutions.keys(),
+                        help="fire solution we play with, repeat to play against several opponents (default: stupid)")
     args = parser.parse_args()
 
 